@@ -0,0 +1,398 @@
+#include "BatchNoise.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CRAFTBONE_NOISE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define CRAFTBONE_NOISE_X86 0
+#endif
+
+// GCC and Clang only emit instructions of the targets enabled for a function
+#if defined(__GNUC__) || defined(__clang__)
+#define CRAFTBONE_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CRAFTBONE_TARGET(isa)
+#endif
+
+namespace
+{
+
+std::atomic<NoiseKernel> s_kernel = NoiseKernel::Scalar;
+
+bool detectSupport(NoiseKernel kernel)
+{
+    if (kernel == NoiseKernel::Scalar) {
+        return true;
+    }
+#if CRAFTBONE_NOISE_X86
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    const auto maxLeaf = info[0];
+    __cpuid(info, 1);
+    const auto sse41 = (info[2] & (1 << 19)) != 0;
+    // AVX registers must be enabled by the OS as well
+    const auto avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+    auto avx2 = false;
+    if (avx && maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    const auto sse41 = __builtin_cpu_supports("sse4.1") != 0;
+    const auto avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+    return kernel == NoiseKernel::SSE41 ? sse41 : avx2;
+#else
+    return false;
+#endif
+}
+
+#if CRAFTBONE_NOISE_X86
+
+// The vector kernels follow siv::BasicPerlinNoise operation by operation, so they round the same way
+
+CRAFTBONE_TARGET("sse4.1")
+__m128 fadeSse(__m128 t)
+{
+    const auto inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+    return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+}
+
+CRAFTBONE_TARGET("sse4.1")
+__m128 lerpSse(__m128 t, __m128 a, __m128 b)
+{
+    return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+
+CRAFTBONE_TARGET("sse4.1")
+__m128 gradSse(__m128i hash, __m128 x, __m128 y, __m128 z)
+{
+    const auto h = _mm_and_si128(hash, _mm_set1_epi32(15));
+    const auto u = _mm_blendv_ps(y, x, _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8))));
+    const auto useX = _mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)), _mm_cmpeq_epi32(h, _mm_set1_epi32(14)));
+    const auto v = _mm_blendv_ps(_mm_blendv_ps(z, x, _mm_castsi128_ps(useX)), y, _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4))));
+    // Bits 0 and 1 of the hash negate u and v
+    const auto uSign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(1)), 31);
+    const auto vSign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), 30);
+    return _mm_add_ps(_mm_xor_ps(u, _mm_castsi128_ps(uSign)), _mm_xor_ps(v, _mm_castsi128_ps(vSign)));
+}
+
+CRAFTBONE_TARGET("sse4.1")
+__m128i lookupSse(const std::int32_t* table, __m128i index)
+{
+    alignas(16) std::int32_t indices[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(indices), index);
+    return _mm_setr_epi32(table[indices[0]], table[indices[1]], table[indices[2]], table[indices[3]]);
+}
+
+CRAFTBONE_TARGET("sse4.1")
+__m128 noiseSse(const std::int32_t* p, __m128 x, __m128 y, __m128 z)
+{
+    const auto mask = _mm_set1_epi32(255);
+    const auto one = _mm_set1_epi32(1);
+    const auto floorX = _mm_floor_ps(x);
+    const auto floorY = _mm_floor_ps(y);
+    const auto floorZ = _mm_floor_ps(z);
+    const auto X = _mm_and_si128(_mm_cvttps_epi32(floorX), mask);
+    const auto Y = _mm_and_si128(_mm_cvttps_epi32(floorY), mask);
+    const auto Z = _mm_and_si128(_mm_cvttps_epi32(floorZ), mask);
+    x = _mm_sub_ps(x, floorX);
+    y = _mm_sub_ps(y, floorY);
+    z = _mm_sub_ps(z, floorZ);
+
+    const auto u = fadeSse(x);
+    const auto v = fadeSse(y);
+    const auto w = fadeSse(z);
+
+    const auto A = _mm_add_epi32(lookupSse(p, X), Y);
+    const auto AA = _mm_add_epi32(lookupSse(p, A), Z);
+    const auto AB = _mm_add_epi32(lookupSse(p, _mm_add_epi32(A, one)), Z);
+    const auto B = _mm_add_epi32(lookupSse(p, _mm_add_epi32(X, one)), Y);
+    const auto BA = _mm_add_epi32(lookupSse(p, B), Z);
+    const auto BB = _mm_add_epi32(lookupSse(p, _mm_add_epi32(B, one)), Z);
+
+    const auto x1 = _mm_sub_ps(x, _mm_set1_ps(1.0f));
+    const auto y1 = _mm_sub_ps(y, _mm_set1_ps(1.0f));
+    const auto z1 = _mm_sub_ps(z, _mm_set1_ps(1.0f));
+    return lerpSse(w,
+        lerpSse(v,
+            lerpSse(u, gradSse(lookupSse(p, AA), x, y, z), gradSse(lookupSse(p, BA), x1, y, z)),
+            lerpSse(u, gradSse(lookupSse(p, AB), x, y1, z), gradSse(lookupSse(p, BB), x1, y1, z))),
+        lerpSse(v,
+            lerpSse(u, gradSse(lookupSse(p, _mm_add_epi32(AA, one)), x, y, z1), gradSse(lookupSse(p, _mm_add_epi32(BA, one)), x1, y, z1)),
+            lerpSse(u, gradSse(lookupSse(p, _mm_add_epi32(AB, one)), x, y1, z1), gradSse(lookupSse(p, _mm_add_epi32(BB, one)), x1, y1, z1))));
+}
+
+// Returns the number of points done, a multiple of 4
+CRAFTBONE_TARGET("sse4.1")
+std::size_t octaveNoiseSse(const std::int32_t* p, const float* xs, const float* ys, const float* zs,
+                           std::int32_t octaves, float* out, std::size_t count)
+{
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto x = _mm_loadu_ps(xs + i);
+        auto y = _mm_loadu_ps(ys + i);
+        auto z = zs ? _mm_loadu_ps(zs + i) : _mm_setzero_ps();
+        auto result = _mm_setzero_ps();
+        auto amp = _mm_set1_ps(1.0f);
+        for (std::int32_t octave = 0; octave < octaves; octave++) {
+            result = _mm_add_ps(result, _mm_mul_ps(noiseSse(p, x, y, z), amp));
+            x = _mm_mul_ps(x, _mm_set1_ps(2.0f));
+            y = _mm_mul_ps(y, _mm_set1_ps(2.0f));
+            z = _mm_mul_ps(z, _mm_set1_ps(2.0f));
+            amp = _mm_div_ps(amp, _mm_set1_ps(2.0f));
+        }
+        result = _mm_add_ps(_mm_mul_ps(result, _mm_set1_ps(0.5f)), _mm_set1_ps(0.5f));
+        _mm_storeu_ps(out + i, _mm_min_ps(_mm_max_ps(result, _mm_setzero_ps()), _mm_set1_ps(1.0f)));
+    }
+    return i;
+}
+
+CRAFTBONE_TARGET("avx2")
+__m256 fadeAvx2(__m256 t)
+{
+    const auto inner = _mm256_add_ps(_mm256_mul_ps(t, _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f))), _mm256_set1_ps(10.0f));
+    return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), inner);
+}
+
+CRAFTBONE_TARGET("avx2")
+__m256 lerpAvx2(__m256 t, __m256 a, __m256 b)
+{
+    return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+}
+
+CRAFTBONE_TARGET("avx2")
+__m256 gradAvx2(__m256i hash, __m256 x, __m256 y, __m256 z)
+{
+    const auto h = _mm256_and_si256(hash, _mm256_set1_epi32(15));
+    const auto u = _mm256_blendv_ps(y, x, _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), h)));
+    const auto useX = _mm256_or_si256(_mm256_cmpeq_epi32(h, _mm256_set1_epi32(12)), _mm256_cmpeq_epi32(h, _mm256_set1_epi32(14)));
+    const auto v = _mm256_blendv_ps(_mm256_blendv_ps(z, x, _mm256_castsi256_ps(useX)), y, _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), h)));
+    const auto uSign = _mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(1)), 31);
+    const auto vSign = _mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(2)), 30);
+    return _mm256_add_ps(_mm256_xor_ps(u, _mm256_castsi256_ps(uSign)), _mm256_xor_ps(v, _mm256_castsi256_ps(vSign)));
+}
+
+CRAFTBONE_TARGET("avx2")
+__m256i lookupAvx2(const std::int32_t* table, __m256i index)
+{
+    return _mm256_i32gather_epi32(table, index, 4);
+}
+
+CRAFTBONE_TARGET("avx2")
+__m256 noiseAvx2(const std::int32_t* p, __m256 x, __m256 y, __m256 z)
+{
+    const auto mask = _mm256_set1_epi32(255);
+    const auto one = _mm256_set1_epi32(1);
+    const auto floorX = _mm256_floor_ps(x);
+    const auto floorY = _mm256_floor_ps(y);
+    const auto floorZ = _mm256_floor_ps(z);
+    const auto X = _mm256_and_si256(_mm256_cvttps_epi32(floorX), mask);
+    const auto Y = _mm256_and_si256(_mm256_cvttps_epi32(floorY), mask);
+    const auto Z = _mm256_and_si256(_mm256_cvttps_epi32(floorZ), mask);
+    x = _mm256_sub_ps(x, floorX);
+    y = _mm256_sub_ps(y, floorY);
+    z = _mm256_sub_ps(z, floorZ);
+
+    const auto u = fadeAvx2(x);
+    const auto v = fadeAvx2(y);
+    const auto w = fadeAvx2(z);
+
+    const auto A = _mm256_add_epi32(lookupAvx2(p, X), Y);
+    const auto AA = _mm256_add_epi32(lookupAvx2(p, A), Z);
+    const auto AB = _mm256_add_epi32(lookupAvx2(p, _mm256_add_epi32(A, one)), Z);
+    const auto B = _mm256_add_epi32(lookupAvx2(p, _mm256_add_epi32(X, one)), Y);
+    const auto BA = _mm256_add_epi32(lookupAvx2(p, B), Z);
+    const auto BB = _mm256_add_epi32(lookupAvx2(p, _mm256_add_epi32(B, one)), Z);
+
+    const auto x1 = _mm256_sub_ps(x, _mm256_set1_ps(1.0f));
+    const auto y1 = _mm256_sub_ps(y, _mm256_set1_ps(1.0f));
+    const auto z1 = _mm256_sub_ps(z, _mm256_set1_ps(1.0f));
+    return lerpAvx2(w,
+        lerpAvx2(v,
+            lerpAvx2(u, gradAvx2(lookupAvx2(p, AA), x, y, z), gradAvx2(lookupAvx2(p, BA), x1, y, z)),
+            lerpAvx2(u, gradAvx2(lookupAvx2(p, AB), x, y1, z), gradAvx2(lookupAvx2(p, BB), x1, y1, z))),
+        lerpAvx2(v,
+            lerpAvx2(u, gradAvx2(lookupAvx2(p, _mm256_add_epi32(AA, one)), x, y, z1), gradAvx2(lookupAvx2(p, _mm256_add_epi32(BA, one)), x1, y, z1)),
+            lerpAvx2(u, gradAvx2(lookupAvx2(p, _mm256_add_epi32(AB, one)), x, y1, z1), gradAvx2(lookupAvx2(p, _mm256_add_epi32(BB, one)), x1, y1, z1))));
+}
+
+// Returns the number of points done, a multiple of 8
+CRAFTBONE_TARGET("avx2")
+std::size_t octaveNoiseAvx2(const std::int32_t* p, const float* xs, const float* ys, const float* zs,
+                            std::int32_t octaves, float* out, std::size_t count)
+{
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto x = _mm256_loadu_ps(xs + i);
+        auto y = _mm256_loadu_ps(ys + i);
+        auto z = zs ? _mm256_loadu_ps(zs + i) : _mm256_setzero_ps();
+        auto result = _mm256_setzero_ps();
+        auto amp = _mm256_set1_ps(1.0f);
+        for (std::int32_t octave = 0; octave < octaves; octave++) {
+            result = _mm256_add_ps(result, _mm256_mul_ps(noiseAvx2(p, x, y, z), amp));
+            x = _mm256_mul_ps(x, _mm256_set1_ps(2.0f));
+            y = _mm256_mul_ps(y, _mm256_set1_ps(2.0f));
+            z = _mm256_mul_ps(z, _mm256_set1_ps(2.0f));
+            amp = _mm256_div_ps(amp, _mm256_set1_ps(2.0f));
+        }
+        result = _mm256_add_ps(_mm256_mul_ps(result, _mm256_set1_ps(0.5f)), _mm256_set1_ps(0.5f));
+        _mm256_storeu_ps(out + i, _mm256_min_ps(_mm256_max_ps(result, _mm256_setzero_ps()), _mm256_set1_ps(1.0f)));
+    }
+    return i;
+}
+
+#endif
+
+}
+
+BatchNoise::BatchNoise(const siv::BasicPerlinNoise<float>& noise)
+    : m_noise(noise)
+{
+    std::array<std::uint8_t, 256> permutation;
+    noise.serialize(permutation);
+    for (std::size_t i = 0; i < m_permutation.size(); i++) {
+        m_permutation[i] = permutation[i % permutation.size()];
+    }
+
+    static std::once_flag s_kernelSelected;
+    std::call_once(s_kernelSelected, [this] {
+        for (const auto kernel : { NoiseKernel::AVX2, NoiseKernel::SSE41 }) {
+            if (isSupported(kernel) && matchesScalar(kernel)) {
+                s_kernel = kernel;
+                break;
+            }
+        }
+        Logger::log(Logger::Severity::Info, std::string("Noise kernel: ") + name(s_kernel));
+    });
+}
+
+void BatchNoise::accumulatedOctaveNoise3D_0_1(std::span<const float> x, std::span<const float> y, std::span<const float> z,
+                                              std::int32_t octaves, std::span<float> out) const
+{
+    evaluate(kernel(), x.data(), y.data(), z.data(), octaves, out.data(), out.size());
+}
+
+void BatchNoise::accumulatedOctaveNoise2D_0_1(std::span<const float> x, std::span<const float> y,
+                                              std::int32_t octaves, std::span<float> out) const
+{
+    evaluate(kernel(), x.data(), y.data(), nullptr, octaves, out.data(), out.size());
+}
+
+NoiseKernel BatchNoise::kernel()
+{
+    return s_kernel.load();
+}
+
+bool BatchNoise::isSupported(NoiseKernel kernel)
+{
+    static const std::array<bool, 3> s_supported {
+        detectSupport(NoiseKernel::Scalar),
+        detectSupport(NoiseKernel::SSE41),
+        detectSupport(NoiseKernel::AVX2),
+    };
+    return s_supported.at(std::size_t(kernel));
+}
+
+const char* BatchNoise::name(NoiseKernel kernel)
+{
+    switch (kernel) {
+        case NoiseKernel::Scalar: return "Scalar";
+        case NoiseKernel::SSE41: return "SSE4.1";
+        case NoiseKernel::AVX2: return "AVX2";
+    }
+    return "Unknown";
+}
+
+void BatchNoise::evaluate(NoiseKernel kernel, const float* x, const float* y, const float* z,
+                          std::int32_t octaves, float* out, std::size_t count) const
+{
+    std::size_t done = 0;
+#if CRAFTBONE_NOISE_X86
+    switch (kernel) {
+        case NoiseKernel::AVX2: done = octaveNoiseAvx2(m_permutation.data(), x, y, z, octaves, out, count); break;
+        case NoiseKernel::SSE41: done = octaveNoiseSse(m_permutation.data(), x, y, z, octaves, out, count); break;
+        case NoiseKernel::Scalar: break;
+    }
+#endif
+    // The points left over from the vector kernels
+    for (auto i = done; i < count; i++) {
+        out[i] = m_noise.accumulatedOctaveNoise3D_0_1(x[i], y[i], z ? z[i] : 0.0f, octaves);
+    }
+}
+
+bool BatchNoise::matchesScalar(NoiseKernel kernel) const
+{
+    // Points on both sides of zero, on lattice planes and beyond the 256 period of the permutation
+    constexpr std::size_t count = 1024;
+    std::vector<float> x(count), y(count), z(count), expected(count), actual(count);
+    for (std::size_t i = 0; i < count; i++) {
+        x[i] = float(int(i % 37) - 18) * 0.37f + float(i / 256) * 97.0f;
+        y[i] = float(int(i % 11) - 5) * 0.5f;
+        z[i] = float(int(i % 23) - 11) * 1.13f - float(i / 512) * 300.0f;
+    }
+    for (std::size_t i = 0; i < count; i++) {
+        expected[i] = m_noise.accumulatedOctaveNoise3D_0_1(x[i], y[i], z[i], 5);
+    }
+    evaluate(kernel, x.data(), y.data(), z.data(), 5, actual.data(), count);
+
+    auto maxError = 0.0f;
+    std::size_t exact = 0;
+    for (std::size_t i = 0; i < count; i++) {
+        maxError = std::max(maxError, std::abs(expected[i] - actual[i]));
+        exact += std::bit_cast<std::uint32_t>(expected[i]) == std::bit_cast<std::uint32_t>(actual[i]) ? 1 : 0;
+    }
+
+    // Bit exact unless the compiler contracted the scalar noise into fused multiply-adds
+    const auto matches = maxError <= 1e-5f;
+    Logger::log(matches ? Logger::Severity::Info : Logger::Severity::Medium,
+        std::string(name(kernel)) + " noise: " + std::to_string(exact) + "/" + std::to_string(count)
+        + " points bit exact, max error " + std::to_string(maxError) + (matches ? "" : ", not used"));
+    return matches;
+}
+
+double BatchNoise::benchmark(NoiseKernel kernel) const
+{
+    if (!isSupported(kernel)) {
+        return 0.0;
+    }
+
+    // A column of 64 blocks, as chunk generation evaluates them
+    constexpr std::size_t count = 64;
+    std::array<float, count> x, y, z, out;
+    x.fill(12.3f);
+    z.fill(-4.56f);
+    for (std::size_t i = 0; i < count; i++) {
+        y[i] = float(i) / 32.0f;
+    }
+
+    std::size_t points = 0;
+    auto sink = 0.0f;
+    const auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration<double>::zero();
+    while (elapsed.count() < 0.1) {
+        for (auto i = 0; i < 256; i++) {
+            evaluate(kernel, x.data(), y.data(), z.data(), 2, out.data(), count);
+            sink += out[i % count];
+            x[0] += 1.0f / 64.0f;
+        }
+        points += 256 * count;
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    return sink >= 0.0f ? double(points) / elapsed.count() : 0.0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+#include "../lib/PerlinNoise.hpp"
+
+// Instruction set BatchNoise evaluates the noise with
+enum class NoiseKernel
+{
+    Scalar, // One point at a time through siv::BasicPerlinNoise
+    SSE41, // 4 points at a time
+    AVX2, // 8 points at a time, with gathers for the permutation lookups
+};
+
+// Evaluates siv::BasicPerlinNoise<float> for many points at once, with the same results as the
+// scalar functions of the noise it was built from. The kernel is picked on first use, as the
+// best one the CPU supports that also agrees with the scalar noise on a set of test points.
+class BatchNoise
+{
+public:
+    explicit BatchNoise(const siv::BasicPerlinNoise<float>& noise);
+
+    // out[i] = noise.accumulatedOctaveNoise3D_0_1(x[i], y[i], z[i], octaves). All spans have the same size.
+    void accumulatedOctaveNoise3D_0_1(std::span<const float> x, std::span<const float> y, std::span<const float> z,
+                                      std::int32_t octaves, std::span<float> out) const;
+
+    // out[i] = noise.accumulatedOctaveNoise2D_0_1(x[i], y[i], octaves)
+    void accumulatedOctaveNoise2D_0_1(std::span<const float> x, std::span<const float> y,
+                                      std::int32_t octaves, std::span<float> out) const;
+
+    [[nodiscard]] static NoiseKernel kernel();
+    [[nodiscard]] static bool isSupported(NoiseKernel kernel);
+    [[nodiscard]] static const char* name(NoiseKernel kernel);
+
+    // Points per second of 2 octave 3D noise, the terrain's density, with the given kernel
+    [[nodiscard]] double benchmark(NoiseKernel kernel) const;
+
+private:
+    // z may be nullptr for 2D noise
+    void evaluate(NoiseKernel kernel, const float* x, const float* y, const float* z,
+                  std::int32_t octaves, float* out, std::size_t count) const;
+
+    // Whether the kernel agrees with the scalar noise within a tiny tolerance. Logs the result.
+    [[nodiscard]] bool matchesScalar(NoiseKernel kernel) const;
+
+    siv::BasicPerlinNoise<float> m_noise;
+    // The noise's permutation table widened to 32 bits for gathers, repeated like in siv::BasicPerlinNoise
+    std::array<std::int32_t, 512> m_permutation {};
+};
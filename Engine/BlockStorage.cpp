@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cassert>
+
+#include "BlockStorage.h"
+
+namespace
+{
+
+// Smallest supported bit width that can address the given number of palette entries.
+// Widths are powers of two so an index never straddles two words.
+std::size_t bitsForEntries(std::size_t entries)
+{
+    std::size_t bits = 0;
+    while ((std::size_t{1} << bits) < entries) {
+        bits = bits == 0 ? 1 : bits * 2;
+    }
+    return bits;
+}
+
+std::size_t log2OfBits(std::size_t bits)
+{
+    std::size_t shift = 0;
+    while ((std::size_t{1} << shift) < bits) {
+        shift++;
+    }
+    return shift;
+}
+
+std::uint32_t readPacked(const std::vector<std::uint64_t>& words, std::size_t bitsShift, std::size_t index)
+{
+    const auto perWordShift = 6 - bitsShift;
+    const auto bitOffset = (index & ((std::size_t{1} << perWordShift) - 1)) << bitsShift;
+    const auto mask = (std::uint64_t{1} << (std::size_t{1} << bitsShift)) - 1;
+    return std::uint32_t((words[index >> perWordShift] >> bitOffset) & mask);
+}
+
+void writePacked(std::vector<std::uint64_t>& words, std::size_t bitsShift, std::size_t index, std::uint32_t value)
+{
+    const auto perWordShift = 6 - bitsShift;
+    const auto bitOffset = (index & ((std::size_t{1} << perWordShift) - 1)) << bitsShift;
+    const auto mask = ((std::uint64_t{1} << (std::size_t{1} << bitsShift)) - 1) << bitOffset;
+    auto& word = words[index >> perWordShift];
+    word = (word & ~mask) | ((std::uint64_t(value) << bitOffset) & mask);
+}
+
+}
+
+namespace Engine
+{
+
+BlockStorage::BlockStorage(std::size_t size, BlockType type)
+    : m_size(size)
+{
+    fill(type);
+}
+
+BlockType BlockStorage::get(std::size_t index) const
+{
+    assert(index < m_size);
+    return m_palette[readIndex(index)];
+}
+
+void BlockStorage::set(std::size_t index, BlockType type)
+{
+    assert(index < m_size);
+    if (m_palette[readIndex(index)] == type) {
+        return;
+    }
+
+    const auto newIndex = acquirePaletteIndex(type);
+    // Acquiring may have repacked the storage, so read the old index afterwards
+    const auto oldIndex = readIndex(index);
+    writeIndex(index, newIndex);
+    m_refCounts[newIndex]++;
+    releasePaletteIndex(oldIndex);
+}
+
+void BlockStorage::unpack(std::span<BlockType> blocks) const
+{
+    assert(blocks.size() == m_size);
+    if (m_bits == 0) {
+        std::fill(blocks.begin(), blocks.end(), m_palette[0]);
+        return;
+    }
+
+    const auto perWord = std::size_t{64} >> m_bitsShift;
+    const auto mask = (std::uint64_t{1} << m_bits) - 1;
+    for (std::size_t wordIndex = 0; wordIndex < m_words.size(); wordIndex++) {
+        auto word = m_words[wordIndex];
+        const auto first = wordIndex * perWord;
+        const auto count = std::min(perWord, m_size - first);
+        for (std::size_t i = 0; i < count; i++) {
+            blocks[first + i] = m_palette[word & mask];
+            word >>= m_bits;
+        }
+    }
+}
+
+void BlockStorage::fill(BlockType type)
+{
+    m_bits = 0;
+    m_bitsShift = 0;
+    m_palette.assign(1, type);
+    m_refCounts.assign(1, std::uint32_t(m_size));
+    m_words = {};
+}
+
+std::size_t BlockStorage::paletteSize() const
+{
+    std::size_t live = 0;
+    for (auto count : m_refCounts) {
+        live += count > 0 ? 1 : 0;
+    }
+    return live;
+}
+
+std::size_t BlockStorage::memoryUsage() const
+{
+    return sizeof(*this)
+        + m_palette.capacity() * sizeof(BlockType)
+        + m_refCounts.capacity() * sizeof(std::uint32_t)
+        + m_words.capacity() * sizeof(std::uint64_t);
+}
+
+std::uint32_t BlockStorage::readIndex(std::size_t index) const
+{
+    return m_bits == 0 ? 0 : readPacked(m_words, m_bitsShift, index);
+}
+
+void BlockStorage::writeIndex(std::size_t index, std::uint32_t paletteIndex)
+{
+    assert(m_bits > 0);
+    writePacked(m_words, m_bitsShift, index, paletteIndex);
+}
+
+std::uint32_t BlockStorage::acquirePaletteIndex(BlockType type)
+{
+    auto freeSlot = m_palette.size();
+    for (std::size_t i = 0; i < m_palette.size(); i++) {
+        if (m_refCounts[i] == 0) {
+            freeSlot = std::min(freeSlot, i);
+        }
+        else if (m_palette[i] == type) {
+            return std::uint32_t(i);
+        }
+    }
+
+    if (freeSlot < m_palette.size()) {
+        m_palette[freeSlot] = type;
+        return std::uint32_t(freeSlot);
+    }
+
+    // Every entry is in use, widen the indices before adding a new one
+    if (m_palette.size() + 1 > (std::size_t{1} << m_bits)) {
+        repack(bitsForEntries(m_palette.size() + 1));
+    }
+    m_palette.push_back(type);
+    m_refCounts.push_back(0);
+    return std::uint32_t(m_palette.size() - 1);
+}
+
+void BlockStorage::releasePaletteIndex(std::uint32_t paletteIndex)
+{
+    if (--m_refCounts[paletteIndex] > 0) {
+        return;
+    }
+
+    // Only shrink once the palette fits in a quarter of the current width, so a block
+    // toggling back and forth at a width boundary does not repack the storage every time.
+    const auto live = paletteSize();
+    if (live <= 1) {
+        repack(0);
+    }
+    else if (bitsForEntries(live) < m_bits && live <= (std::size_t{1} << m_bits) / 4) {
+        repack(bitsForEntries(live));
+    }
+}
+
+void BlockStorage::repack(std::size_t bits)
+{
+    std::vector<std::uint32_t> remap(m_palette.size(), 0);
+    std::vector<BlockType> palette;
+    std::vector<std::uint32_t> refCounts;
+    for (std::size_t i = 0; i < m_palette.size(); i++) {
+        if (m_refCounts[i] > 0) {
+            remap[i] = std::uint32_t(palette.size());
+            palette.push_back(m_palette[i]);
+            refCounts.push_back(m_refCounts[i]);
+        }
+    }
+    assert(bitsForEntries(palette.size()) <= bits);
+
+    const auto bitsShift = log2OfBits(bits);
+    std::vector<std::uint64_t> words;
+    if (bits > 0) {
+        words.resize((m_size * bits + 63) / 64, 0);
+        for (std::size_t i = 0; i < m_size; i++) {
+            writePacked(words, bitsShift, i, remap[readIndex(i)]);
+        }
+    }
+
+    m_bits = bits;
+    m_bitsShift = bitsShift;
+    m_words = std::move(words);
+    m_palette = std::move(palette);
+    m_refCounts = std::move(refCounts);
+}
+
+}
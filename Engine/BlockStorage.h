@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace Engine
+{
+
+    enum class BlockType;
+
+    // Stores a fixed number of blocks as indices into a palette of the block types
+    // actually present. Indices are bit packed into 64 bit words and the bit width
+    // grows and shrinks with the palette, so a block costs 0, 1, 2, 4, 8 or 16 bits
+    // instead of sizeof(BlockType).
+    class BlockStorage
+    {
+    public:
+
+        BlockStorage(std::size_t size, BlockType type);
+
+        [[nodiscard]] BlockType get(std::size_t index) const;
+        void set(std::size_t index, BlockType type);
+
+        // Decodes every block in index order into blocks, which must hold size() entries
+        void unpack(std::span<BlockType> blocks) const;
+
+        // Resets every block to type and releases the index array
+        void fill(BlockType type);
+
+        // A uniform storage holds a single block type and no index array
+        [[nodiscard]] bool isUniform() const { return m_bits == 0; }
+
+        [[nodiscard]] std::size_t size() const { return m_size; }
+        [[nodiscard]] std::size_t bitsPerBlock() const { return m_bits; }
+        [[nodiscard]] std::size_t paletteSize() const;
+
+        // Heap and inline bytes held by this storage
+        [[nodiscard]] std::size_t memoryUsage() const;
+
+    private:
+
+        [[nodiscard]] std::uint32_t readIndex(std::size_t index) const;
+        void writeIndex(std::size_t index, std::uint32_t paletteIndex);
+
+        std::uint32_t acquirePaletteIndex(BlockType type);
+        void releasePaletteIndex(std::uint32_t paletteIndex);
+
+        // Repacks all indices with the given bit width, dropping unused palette entries
+        void repack(std::size_t bits);
+
+        std::size_t m_size;
+        std::size_t m_bits = 0;
+        std::size_t m_bitsShift = 0; // log2(m_bits), only valid when m_bits > 0
+        std::vector<BlockType> m_palette;
+        std::vector<std::uint32_t> m_refCounts; // Number of blocks using each palette entry
+        std::vector<std::uint64_t> m_words;
+    };
+
+}
@@ -1,10 +1,18 @@
 #include <cstdint>
 #include <vector>
 
-#include <GL/glew.h>
-
 #include "Chunk.h"
 
+namespace
+{
+
+std::size_t sectionIndex(int x, int y, int z)
+{
+    return std::size_t(x + ChunkData::SECTIONS_X * (y + ChunkData::SECTIONS_Y * z));
+}
+
+}
+
 namespace Engine
 {
 
@@ -13,12 +21,22 @@ Chunk::Chunk(glm::vec3 pos, GLuint texture, BlockType typ)
     , m_startPos(pos)
     , m_texture(texture)
 {
-    m_blocks.fill(typ);
+    if (typ != BlockType::AIR) {
+        for (auto& section : m_sections) {
+            section = std::make_unique<ChunkSection>(typ);
+        }
+        m_solidMask.fill(~std::uint64_t{0});
+    }
 
     m_neighbors.fill(nullptr);
 }
 
 Chunk::~Chunk()
+{
+    unlinkNeighbors();
+}
+
+void Chunk::unlinkNeighbors()
 {
     using Pairs = std::vector<std::pair<Direction, Direction>>;
     static const auto s_dirPairs = Pairs {
@@ -36,35 +54,83 @@ Chunk::~Chunk()
             otherChunk->setNeighbor(nullptr, thisDir);
         }
     }
-
-    glDeleteBuffers(1, &m_vbo);
-    glDeleteVertexArrays(1, &m_vao);
+    m_neighbors.fill(nullptr);
 }
 
 BlockType Chunk::get(int x, int y, int z) const
 {
-    return m_blocks.at(x + ChunkData::BLOCKS_X * (y + ChunkData::BLOCKS_Y * z));
+    constexpr auto extent = ChunkData::SECTION_EXTENT;
+    const auto& section = m_sections.at(sectionIndex(x / extent, y / extent, z / extent));
+    return section ? section->get(x % extent, y % extent, z % extent) : BlockType::AIR;
 }
 
 void Chunk::set(int x, int y, int z, BlockType type)
 {
-    m_changed = true;
-    m_blocks.at(x + ChunkData::BLOCKS_X * (y + ChunkData::BLOCKS_Y * z)) = type;
+    const auto bit = std::uint64_t{1} << x;
+    auto& row = m_solidMask.at(std::size_t(y + ChunkData::BLOCKS_Y * z));
+    row = type == BlockType::AIR ? row & ~bit : row | bit;
+
+    constexpr auto extent = ChunkData::SECTION_EXTENT;
+    auto& section = m_sections.at(sectionIndex(x / extent, y / extent, z / extent));
+    if (!section) {
+        if (type == BlockType::AIR) {
+            return;
+        }
+        section = std::make_unique<ChunkSection>(BlockType::AIR);
+    }
+
+    section->set(x % extent, y % extent, z % extent, type);
+    if (section->isEmpty()) {
+        section.reset();
+    }
 }
 
-void Chunk::render()
+std::optional<BlockType> Chunk::uniformType() const
 {
-    if (m_changed){
-        m_changed = false;
-        addMeshData(m_mesh);
+    const auto sectionType = [](const std::unique_ptr<ChunkSection>& section) {
+        return section ? section->uniformType() : std::make_optional(BlockType::AIR);
+    };
+
+    const auto firstType = sectionType(m_sections.front());
+    if (!firstType) {
+        return std::nullopt;
     }
+    for (const auto& section : m_sections) {
+        if (sectionType(section) != firstType) {
+            return std::nullopt;
+        }
+    }
+    return firstType;
+}
+
+const ChunkSection* Chunk::section(int x, int y, int z) const
+{
+    return m_sections.at(sectionIndex(x, y, z)).get();
+}
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_texture);
+std::size_t Chunk::allocatedSections() const
+{
+    std::size_t count = 0;
+    for (const auto& section : m_sections) {
+        count += section ? 1 : 0;
+    }
+    return count;
+}
 
-    glBindVertexArray(m_vao);
+std::size_t Chunk::blockMemoryUsage() const
+{
+    auto bytes = sizeof(m_sections) + sizeof(m_solidMask);
+    for (const auto& section : m_sections) {
+        bytes += section ? section->memoryUsage() : 0;
+    }
+    return bytes;
+}
 
-    glDrawArrays(GL_TRIANGLES, 0, m_vertices);
+std::size_t Chunk::render(const glm::vec3& cameraPos)
+{
+    const auto min = glm::vec3(m_startPos);
+    const auto max = min + glm::vec3(ChunkData::BLOCKS_X, ChunkData::BLOCKS_Y, ChunkData::BLOCKS_Z);
+    return m_gpuMesh.render(min, max, cameraPos, m_texture);
 }
 
 void Chunk::setNeighbor(Chunk* chunk, Direction dir)
@@ -77,6 +143,22 @@ Chunk* Chunk::neighbor(Direction dir)
     return m_neighbors.at(std::size_t(dir));
 }
 
+const Chunk* Chunk::neighbor(Direction dir) const
+{
+    return m_neighbors.at(std::size_t(dir));
+}
+
+MeshDetail Chunk::meshDetail() const
+{
+    auto detail = MeshDetail{ m_lod, 0 };
+    for (std::size_t dir = 0; dir < m_neighbors.size(); dir++) {
+        if (m_neighbors[dir] && m_neighbors[dir]->lod() != m_lod) {
+            detail.seams |= std::uint8_t(1 << dir);
+        }
+    }
+    return detail;
+}
+
 glm::ivec3 Chunk::pos() const
 {
     return m_startPos;
@@ -91,40 +173,14 @@ glm::ivec3 Chunk::getCenterPos() const
     };
 }
 
-void Chunk::updateVbo()
+UploadResult Chunk::addMeshData(ChunkMesh& mesh, std::uint64_t sequence)
 {
-    regenerateMesh();
-
-    addMeshData(m_mesh);
+    return m_gpuMesh.upload(mesh, sequence);
 }
 
-void Chunk::regenerateMesh()
+UploadResult Chunk::patchMeshData(ChunkMesh& patch, std::uint64_t sequence)
 {
-    m_mesh.regenerate();
-}
-
-void Chunk::addMeshData(const ChunkMesh& mesh)
-{
-    static auto s_glDataInitialized = false;
-
-    if (!s_glDataInitialized) {
-        glGenBuffers(1, &m_vbo);
-        glGenVertexArrays(1, &m_vao);
-
-        glBindVertexArray(m_vao);
-
-        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, textureCoord)));
-        glVertexAttribPointer(1, 3, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, position)));
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-    }
-
-    m_vertices = mesh.vertices().size();
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-    glBufferData(GL_ARRAY_BUFFER, mesh.vertices().size() * sizeof(Vertex), mesh.vertices().data(), GL_STATIC_DRAW);
+    return m_gpuMesh.patch(patch, sequence);
 }
 
 }
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
 
 #include <gl/glew.h>
 #include <glm/detail/qualifier.hpp>
@@ -8,6 +11,8 @@
 #include <glm/gtc/type_precision.hpp>
 
 #include "ChunkMesh.h"
+#include "ChunkSection.h"
+#include "GpuMesh.h"
 
 namespace ChunkData
 {
@@ -16,6 +21,13 @@ namespace ChunkData
     constexpr auto BLOCKS_Y = 64;
     constexpr auto BLOCKS_Z = 64;
     constexpr auto BLOCKS = BLOCKS_X * BLOCKS_Y * BLOCKS_Z;
+    constexpr auto SECTIONS_X = BLOCKS_X / SECTION_EXTENT;
+    constexpr auto SECTIONS_Y = BLOCKS_Y / SECTION_EXTENT;
+    constexpr auto SECTIONS_Z = BLOCKS_Z / SECTION_EXTENT;
+    constexpr auto SECTIONS = SECTIONS_X * SECTIONS_Y * SECTIONS_Z;
+    constexpr auto SOLID_MASK_WORDS = BLOCKS_Y * BLOCKS_Z; // One 64 bit word per row of blocks along x
+
+    static_assert(BLOCKS_X == 64, "The solid mask stores a row of blocks along x in one 64 bit word");
 }
 
 namespace Engine
@@ -54,35 +66,81 @@ namespace Engine
         [[nodiscard]] BlockType get(int x, int y, int z) const;
         void set(int x, int y, int z, BlockType type);
 
+        // The block type of every block if the chunk only holds one type
+        [[nodiscard]] std::optional<BlockType> uniformType() const;
+
+        // Bit x of a word is set if block (x, y, z) is not air
+        [[nodiscard]] std::uint64_t solidRow(int y, int z) const
+        {
+            return m_solidMask[std::size_t(y + ChunkData::BLOCKS_Y * z)];
+        }
+
+        [[nodiscard]] bool isSolid(int x, int y, int z) const
+        {
+            return ((solidRow(y, z) >> x) & 1) != 0;
+        }
+
+        // Rows are indexed by y + BLOCKS_Y * z
+        [[nodiscard]] const std::array<std::uint64_t, ChunkData::SOLID_MASK_WORDS>& solidMask() const
+        {
+            return m_solidMask;
+        }
+
+        // Section coordinates are in [0, SECTIONS_X/Y/Z). Returns nullptr for all-air sections.
+        [[nodiscard]] const ChunkSection* section(int x, int y, int z) const;
+        [[nodiscard]] std::size_t allocatedSections() const;
+
         [[nodiscard]] const glm::mat4& getModelWorldMatrix() const
         {
             return m_modelWorldMatrix;
         }
 
         void setNeighbor(Chunk* chunk, Direction dir);
+        // Removes the links between this chunk and its neighbors in both directions
+        void unlinkNeighbors();
         Chunk* neighbor(Direction dir);
+        [[nodiscard]] const Chunk* neighbor(Direction dir) const;
+
+        // The level of detail to mesh the chunk at, chosen by the ChunkManager by distance
+        void setLod(std::uint8_t lod) { m_lod = lod; }
+        [[nodiscard]] std::uint8_t lod() const { return m_lod; }
+
+        // The chunk's level of detail plus a seam towards every neighbor at another level
+        [[nodiscard]] MeshDetail meshDetail() const;
+
+        // The detail of the uploaded mesh. Must be called on the render thread.
+        [[nodiscard]] const MeshDetail& uploadedDetail() const { return m_gpuMesh.detail(); }
+        [[nodiscard]] bool hasUploadedMesh() const { return m_gpuMesh.isUploaded(); }
 
-        void render();
+        // Only draws the faces that can point to the camera. Returns the number of drawn vertices.
+        std::size_t render(const glm::vec3& cameraPos);
+
+        [[nodiscard]] std::size_t vertexCount() const { return m_gpuMesh.vertexCount(); }
 
         [[nodiscard]] glm::ivec3 pos() const;
         [[nodiscard]] glm::ivec3 getCenterPos() const;
 
-        void addMeshData(const ChunkMesh& mesh);
-        void regenerateMesh();
+        // Uploads a mesh built by a meshing job, unless a newer one is already shown. sequence
+        // orders the meshes by the blocks they were built from. Must be called on the render thread.
+        UploadResult addMeshData(ChunkMesh& mesh, std::uint64_t sequence);
 
-    private:
+        // Rewrites the slots of the sections in a patch built by ChunkMesh::regenerateSections().
+        // Does not change anything if the patch does not fit the uploaded mesh, in which case the
+        // chunk needs a complete mesh.
+        UploadResult patchMeshData(ChunkMesh& patch, std::uint64_t sequence);
 
-        void updateVbo();
+        // Bytes held by the sections of this chunk
+        [[nodiscard]] std::size_t blockMemoryUsage() const;
+
+    private:
 
         glm::mat4 m_modelWorldMatrix;
         glm::ivec3 m_startPos; // A corner of the chunk from which we construct all vertex positions
-        std::array<BlockType, ChunkData::BLOCKS> m_blocks {};
+        std::array<std::unique_ptr<ChunkSection>, ChunkData::SECTIONS> m_sections {};
+        std::array<std::uint64_t, ChunkData::SOLID_MASK_WORDS> m_solidMask {};
         std::array<Chunk*, 6> m_neighbors {};
-        GLuint m_vbo;
-        GLuint m_vao;
+        std::uint8_t m_lod = 0;
         GLuint m_texture;
-        bool m_changed = true;
-        std::size_t m_vertices = 0;
-        ChunkMesh m_mesh {this};
+        GpuMesh m_gpuMesh;
     };
 }
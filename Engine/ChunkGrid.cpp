@@ -0,0 +1,89 @@
+#include "ChunkGrid.h"
+#include "Chunk.h"
+
+#include <cassert>
+
+ChunkGrid::ChunkGrid(const glm::ivec3& radius)
+    : m_radius(radius)
+    , m_extent(2 * radius + 1)
+    , m_slots(std::size_t(m_extent.x * m_extent.y * m_extent.z))
+{
+}
+
+ChunkGrid::~ChunkGrid() = default;
+
+bool ChunkGrid::contains(const ChunkIndex& index) const
+{
+    const auto offset = glm::abs(index.data() - m_origin.data());
+    return offset.x <= m_radius.x && offset.y <= m_radius.y && offset.z <= m_radius.z;
+}
+
+Engine::Chunk* ChunkGrid::at(const ChunkIndex& index) const
+{
+    if (!contains(index)) {
+        return nullptr;
+    }
+    // Inside the window every slot can only hold the chunk at one index
+    return m_slots[slotAt(slotPosition(index))].chunk.get();
+}
+
+std::array<Engine::Chunk*, 6> ChunkGrid::neighbors(const ChunkIndex& index) const
+{
+    assert(contains(index));
+    const auto position = slotPosition(index);
+    const auto slot = slotAt(position);
+
+    // Steps to the next slot along each axis, wrapping around at the end of the window. A slot
+    // wrapped into holds a chunk on the other side of the window, not a neighbor.
+    std::array<Engine::Chunk*, 6> result{};
+    const auto stride = glm::ivec3{ 1, m_extent.x, m_extent.x * m_extent.y };
+    for (auto axis = 0; axis < 3; axis++) {
+        const auto step = std::ptrdiff_t(stride[axis]);
+        const auto wrap = std::ptrdiff_t(stride[axis]) * m_extent[axis];
+        const auto lower = std::ptrdiff_t(slot) + (position[axis] == 0 ? wrap - step : -step);
+        const auto upper = std::ptrdiff_t(slot) + (position[axis] == m_extent[axis] - 1 ? step - wrap : step);
+        for (auto side = 0; side < 2; side++) {
+            const auto& neighbor = m_slots[std::size_t(side == 0 ? lower : upper)];
+            auto expected = index.data();
+            expected[axis] += side == 0 ? -1 : 1;
+            if (neighbor.chunk && neighbor.index.data() == expected) {
+                result[std::size_t(2 * axis + side)] = neighbor.chunk.get();
+            }
+        }
+    }
+    return result;
+}
+
+void ChunkGrid::insert(const ChunkIndex& index, std::unique_ptr<Engine::Chunk> chunk)
+{
+    assert(contains(index));
+    auto& slot = m_slots[slotAt(slotPosition(index))];
+    assert(!slot.chunk);
+    slot.index = index;
+    slot.chunk = std::move(chunk);
+    m_size++;
+}
+
+std::vector<std::unique_ptr<Engine::Chunk>> ChunkGrid::moveOrigin(const ChunkIndex& origin)
+{
+    m_origin = origin;
+    std::vector<std::unique_ptr<Engine::Chunk>> removed;
+    for (auto& slot : m_slots) {
+        if (slot.chunk && !contains(slot.index)) {
+            removed.push_back(std::move(slot.chunk));
+        }
+    }
+    m_size -= removed.size();
+    return removed;
+}
+
+glm::ivec3 ChunkGrid::slotPosition(const ChunkIndex& index) const
+{
+    // Modulo rounding towards negative infinity, so negative indices wrap around as well
+    return ((index.data() % m_extent) + m_extent) % m_extent;
+}
+
+std::size_t ChunkGrid::slotAt(const glm::ivec3& position) const
+{
+    return std::size_t(position.x + m_extent.x * (position.y + m_extent.y * position.z));
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "utils/Chunkindex.h"
+
+namespace Engine
+{
+    class Chunk;
+}
+
+// The loaded chunks, a window of 2 * radius + 1 chunks along each axis centered on the origin.
+// Every chunk index maps to the slot at the index modulo the window size, so the window wraps
+// around: moving the origin only drops the chunks that left the window and never moves the others.
+// Not synchronized.
+class ChunkGrid
+{
+public:
+    explicit ChunkGrid(const glm::ivec3& radius);
+    ~ChunkGrid();
+
+    [[nodiscard]] const ChunkIndex& origin() const { return m_origin; }
+    [[nodiscard]] bool contains(const ChunkIndex& index) const;
+
+    // The chunk at the index, or nullptr if it is not loaded or outside the window
+    [[nodiscard]] Engine::Chunk* at(const ChunkIndex& index) const;
+
+    // The loaded chunks sharing a face with the chunk at the index, indexed by Engine::Direction.
+    // The index must be inside the window.
+    [[nodiscard]] std::array<Engine::Chunk*, 6> neighbors(const ChunkIndex& index) const;
+
+    // The index must be inside the window and not loaded yet
+    void insert(const ChunkIndex& index, std::unique_ptr<Engine::Chunk> chunk);
+
+    // Centers the window on the origin and returns the chunks that are outside of it now
+    std::vector<std::unique_ptr<Engine::Chunk>> moveOrigin(const ChunkIndex& origin);
+
+    [[nodiscard]] std::size_t size() const { return m_size; }
+
+    // Calls function(index, chunk) for every loaded chunk
+    template <typename Function>
+    void forEach(Function&& function) const
+    {
+        for (const auto& slot : m_slots) {
+            if (slot.chunk) {
+                function(slot.index, *slot.chunk);
+            }
+        }
+    }
+
+private:
+    struct Slot
+    {
+        ChunkIndex index;
+        std::unique_ptr<Engine::Chunk> chunk;
+    };
+
+    [[nodiscard]] glm::ivec3 slotPosition(const ChunkIndex& index) const;
+    [[nodiscard]] std::size_t slotAt(const glm::ivec3& position) const;
+
+    glm::ivec3 m_radius;
+    glm::ivec3 m_extent;
+    ChunkIndex m_origin;
+    std::vector<Slot> m_slots; // Indexed by x + extent.x * (y + extent.y * z) of the slot position
+    std::size_t m_size = 0;
+};
@@ -1,5 +1,7 @@
 #include "ChunkManager.h"
+#include "BlockStorage.h"
 #include "Chunk.h"
+#include "GpuBufferPool.h"
 #include "Shader.h"
 #include "utils/Chunkindex.h"
 
@@ -8,12 +10,44 @@
 #include <glm/gtx/hash.hpp>
 #include <glm/gtx/component_wise.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <tuple>
 #include <iostream>
 #include <functional>
+#include <span>
 
 namespace
 {
     const auto viewDistanceInChunks = chunkViewDistance();
+
+    // Offset to the neighbor chunk, indexed by Engine::Direction
+    const std::array<glm::ivec3, 6> neighborOffsets {
+        glm::ivec3{ -1, 0, 0 }, glm::ivec3{ 1, 0, 0 },
+        glm::ivec3{ 0, -1, 0 }, glm::ivec3{ 0, 1, 0 },
+        glm::ivec3{ 0, 0, -1 }, glm::ivec3{ 0, 0, 1 },
+    };
+
+    Engine::Direction opposite(Engine::Direction dir)
+    {
+        return Engine::Direction(std::size_t(dir) ^ 1);
+    }
+
+    // Highest terrain surface, the heightmap is the squared 2D noise in [0, 1] scaled by it
+    constexpr auto MAX_TERRAIN_HEIGHT = 200;
+
+    // Grass only grows at or above this height, with dirt down to DIRT_DEPTH blocks below it.
+    // Every solid block further down is stone, whatever the surface above it.
+    constexpr auto MIN_GRASS_Y = 0;
+    constexpr auto DIRT_DEPTH = 2;
+
+    // Rounds towards negative infinity, unlike integer division
+    int floorDiv(int value, int divisor)
+    {
+        return value / divisor - (value % divisor < 0 ? 1 : 0);
+    }
 }
 
 class RemoveChunksEvent : public Event
@@ -47,6 +81,54 @@ private:
     ChunkIndex m_offsetIndex;
 };
 
+class ColumnGeneratedEvent : public Event
+{
+public:
+    ColumnGeneratedEvent(GeneratedChunks chunks) : Event(10), m_chunks(std::move(chunks)) {}
+    ~ColumnGeneratedEvent() override = default;
+
+    [[nodiscard]] GeneratedChunks& chunks() { return m_chunks; }
+
+private:
+    GeneratedChunks m_chunks;
+};
+
+class MeshChunkEvent : public Event
+{
+public:
+    MeshChunkEvent(ChunkIndex index, EditTime editTime) : Event(5), m_index(std::move(index)), m_editTime(editTime) {}
+    ~MeshChunkEvent() override = default;
+
+    [[nodiscard]] const ChunkIndex& index() const { return m_index; }
+    [[nodiscard]] const EditTime& editTime() const { return m_editTime; }
+
+private:
+    ChunkIndex m_index;
+    EditTime m_editTime;
+};
+
+class SetBlockEvent : public Event
+{
+public:
+    SetBlockEvent(glm::ivec3 worldPos, Engine::BlockType type) :
+        Event(2),
+        m_worldPos(worldPos),
+        m_type(type),
+        m_time(std::chrono::steady_clock::now())
+    {}
+
+    ~SetBlockEvent() override = default;
+
+    [[nodiscard]] const glm::ivec3& worldPos() const { return m_worldPos; }
+    [[nodiscard]] Engine::BlockType type() const { return m_type; }
+    [[nodiscard]] std::chrono::steady_clock::time_point time() const { return m_time; }
+
+private:
+    glm::ivec3 m_worldPos;
+    Engine::BlockType m_type;
+    std::chrono::steady_clock::time_point m_time;
+};
+
 class NewOriginChunkEvent : public Event
 {
 public:
@@ -59,6 +141,37 @@ private:
     ChunkIndex m_index;
 };
 
+class LodRingsEvent : public Event
+{
+public:
+    LodRingsEvent(LodRings rings) : Event(3), m_rings(rings) {}
+    ~LodRingsEvent() override = default;
+
+    [[nodiscard]] const LodRings& rings() const { return m_rings; }
+
+private:
+    LodRings m_rings;
+};
+
+class DensitySamplingEvent : public Event
+{
+public:
+    DensitySamplingEvent(DensitySampling sampling) : Event(3), m_sampling(sampling) {}
+    ~DensitySamplingEvent() override = default;
+
+    [[nodiscard]] const DensitySampling& sampling() const { return m_sampling; }
+
+private:
+    DensitySampling m_sampling;
+};
+
+class CompareDensityEvent : public Event
+{
+public:
+    CompareDensityEvent() : Event(3) {}
+    ~CompareDensityEvent() override = default;
+};
+
 /////////////////////////////////////////////////////////////////////////////////////////////
 
 class ChunkManagerThread : public EventThread
@@ -144,26 +257,71 @@ void ChunkManagerThread::handleEvent(Event* ev)
             return;
         }
 
-        for (auto yIndex = viewDistanceInChunks.y; yIndex > -viewDistanceInChunks.y; yIndex--) {
-            m_parent->ensureChunkAtIndex(ChunkIndex{ index + glm::ivec3{0, yIndex, 0} });
-        }
+        m_parent->requestColumn(index);
 
         pushEvent(std::make_unique<GenerateChunkEvent>(m_parent->m_playerChunk.value(), nextIndexOpt.value()));
     }
+    else if (auto columnGeneratedEvent = dynamic_cast<ColumnGeneratedEvent*>(ev)) {
+        auto& chunks = columnGeneratedEvent->chunks();
+        for (const auto& [index, chunk] : chunks) {
+            m_parent->m_pendingChunks.erase(index.data());
+        }
+        // The player may have moved away while the column was generated
+        std::erase_if(chunks, [this](const auto& generated) {
+            return !m_parent->isWithinViewDistance(generated.first, m_parent->m_playerChunk.value()) || m_parent->chunkAt(generated.first);
+        });
+        if (!chunks.empty()) {
+            m_parent->insertChunks(std::move(chunks));
+        }
+    }
+    else if (auto meshChunkEvent = dynamic_cast<MeshChunkEvent*>(ev)) {
+        m_parent->requestRemesh(meshChunkEvent->index(), meshChunkEvent->editTime());
+    }
+    else if (auto setBlockEvent = dynamic_cast<SetBlockEvent*>(ev)) {
+        m_parent->applyBlockEdit(setBlockEvent->worldPos(), setBlockEvent->type(), setBlockEvent->time());
+    }
+    else if (auto lodRingsEvent = dynamic_cast<LodRingsEvent*>(ev)) {
+        m_parent->m_lodRings = lodRingsEvent->rings();
+        m_parent->updateLods();
+    }
+    else if (auto densitySamplingEvent = dynamic_cast<DensitySamplingEvent*>(ev)) {
+        // Only chunks generated from now on use the new sampling, so start the averages over
+        m_parent->m_densitySampling = densitySamplingEvent->sampling();
+        m_parent->m_generatedChunks = 0;
+        m_parent->m_generationMicroseconds = 0;
+        m_parent->m_densityEvaluations = 0;
+    }
+    else if (dynamic_cast<CompareDensityEvent*>(ev)) {
+        m_parent->runDensityComparison();
+    }
     else if (auto newOriginChunkEvent = dynamic_cast<NewOriginChunkEvent*>(ev)) {
         m_parent->m_playerChunk = newOriginChunkEvent->index();
-        std::vector<std::size_t> outsideChunkKeys;
+        std::vector<std::unique_ptr<Engine::Chunk>> unloadedChunks;
         {
-            std::unique_lock<std::mutex> lck(m_parent->m_chunksMutex);
-            for (auto& [key, chunk] : m_parent->m_chunks) {
-                if (!m_parent->isWithinViewDistance(chunk.get(), newOriginChunkEvent->index().toWorldPos())) {
-                    outsideChunkKeys.push_back(key);
-                }
-            }
-            for (auto key : outsideChunkKeys) {
-                m_parent->m_chunks.erase(key);
+            std::unique_lock<std::shared_mutex> blocksLock(m_parent->m_blocksMutex);
+            auto lck = m_parent->lockChunks();
+            unloadedChunks = m_parent->m_chunks.moveOrigin(newOriginChunkEvent->index());
+            // The render thread destroys them later, the chunks that stay must not point to them by then
+            for (auto& chunk : unloadedChunks) {
+                chunk->unlinkNeighbors();
             }
         }
+        m_parent->publishRenderList(std::move(unloadedChunks));
+        {
+            std::unique_lock<std::mutex> lck(m_parent->m_heightmapsMutex);
+            m_parent->m_heightmapsOrigin = glm::ivec2{ newOriginChunkEvent->index().data().x, newOriginChunkEvent->index().data().z };
+            std::erase_if(m_parent->m_heightmaps, [this](const auto& heightmap) {
+                return !m_parent->isColumnWithinViewDistance(heightmap.first, *m_parent->m_heightmapsOrigin);
+            });
+        }
+        {
+            std::unique_lock<std::mutex> lck(m_parent->m_columnSurfacesMutex);
+            m_parent->m_columnSurfacesOrigin = glm::ivec2{ newOriginChunkEvent->index().data().x, newOriginChunkEvent->index().data().z };
+            std::erase_if(m_parent->m_columnSurfaces, [this](const auto& surface) {
+                return !m_parent->isColumnWithinViewDistance(surface.first, *m_parent->m_columnSurfacesOrigin);
+            });
+        }
+        m_parent->updateLods();
         // New start for chunk generation
         pushEvent(std::make_unique<GenerateChunkEvent>(m_parent->m_playerChunk.value(), ChunkIndex{ {0,0,0} }));
     }
@@ -174,27 +332,262 @@ void ChunkManagerThread::handleEvent(Event* ev)
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 
-ChunkManager::ChunkManager(GLuint texture)
-    : m_thread(new ChunkManagerThread{ this })
+ChunkManager::ChunkManager(GLuint texture, JobSystem& jobs)
+    : m_jobs(jobs)
+    , m_thread(new ChunkManagerThread{ this })
+    , m_chunks(chunkViewDistance())
+    , m_latestRenderList(std::make_unique<RenderList>())
+    , m_renderList(m_latestRenderList.get())
+    , m_texture(texture)
 {
-    m_chunks.reserve(viewDistanceInChunks.x * viewDistanceInChunks.y * viewDistanceInChunks.z);
-
     sourceChunk.onChange.listen(m_observer, [this](const glm::ivec3& index) {
         m_thread->pushEvent(std::make_unique<NewOriginChunkEvent>(ChunkIndex{ index }));
     });
+    m_thread->start();
 }
 
 ChunkManager::~ChunkManager()
 {
     m_thread->stop();
     m_thread->join();
+    // Jobs refer to this manager
+    m_jobs.wait();
 }
 
-bool ChunkManager::isWithinViewDistance(Engine::Chunk* chunk, const glm::vec3& playerPos) const
+double ChunkManager::benchmarkWorldLoad(std::size_t workers)
 {
-    // Get chunk position relative to player
+    JobSystem jobs(workers);
+    const auto start = std::chrono::steady_clock::now();
+    ChunkManager manager(0, jobs);
+    const auto chunks = loadBenchmarkWorld(manager);
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return double(chunks) / seconds;
+}
 
-    return isWithinViewDistance(ChunkIndex::fromWorldPos(chunk->pos()), ChunkIndex::fromWorldPos(playerPos));
+std::size_t ChunkManager::loadBenchmarkWorld(ChunkManager& manager)
+{
+    const auto expectedChunks = std::size_t((2 * viewDistanceInChunks.x + 1) * (2 * viewDistanceInChunks.z + 1) * 2 * viewDistanceInChunks.y);
+    manager.sourceChunk.set({ 16, 1, 16 });
+    while (manager.m_insertedChunks < expectedChunks) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // All meshing jobs of the inserted chunks have been submitted by now
+    manager.m_jobs.wait();
+    return expectedChunks;
+}
+
+void ChunkManager::forEachBenchmarkChunk(const std::function<void(Engine::Chunk&)>& function)
+{
+    ChunkManager manager(0);
+    loadBenchmarkWorld(manager);
+    // Read like the render thread does, nothing changes the blocks of the loaded chunks anymore
+    for (const auto& [index, chunk] : manager.acquireRenderList().chunks) {
+        function(*chunk);
+    }
+}
+
+MesherComparison ChunkManager::compareMeshers()
+{
+    using Face = std::array<std::uint32_t, 4>;
+    // The faces of a mesh in a canonical order, without the degenerate ones filling spare capacity
+    const auto facesOf = [](const ChunkMesh& mesh) {
+        std::vector<Face> faces;
+        const auto& vertices = mesh.vertices();
+        for (std::size_t first = 0; first + 4 <= vertices.size(); first += 4) {
+            auto face = Face{ vertices[first].data, vertices[first + 1].data, vertices[first + 2].data, vertices[first + 3].data };
+            if (face[0] == face[1] && face[1] == face[2] && face[2] == face[3]) {
+                continue;
+            }
+            std::sort(face.begin(), face.end());
+            faces.push_back(face);
+        }
+        std::sort(faces.begin(), faces.end());
+        return faces;
+    };
+
+    MesherComparison result;
+    std::chrono::steady_clock::duration naiveTime {};
+    std::chrono::steady_clock::duration binaryTime {};
+    const auto previousMode = ChunkMesh::mode();
+    forEachBenchmarkChunk([&](Engine::Chunk& chunk) {
+        ChunkMesh::setMode(MeshingMode::Naive);
+        ChunkMesh naive(&chunk);
+        auto start = std::chrono::steady_clock::now();
+        naive.regenerate();
+        naiveTime += std::chrono::steady_clock::now() - start;
+
+        ChunkMesh::setMode(MeshingMode::Binary);
+        ChunkMesh binary(&chunk);
+        start = std::chrono::steady_clock::now();
+        binary.regenerate();
+        binaryTime += std::chrono::steady_clock::now() - start;
+
+        const auto naiveFaces = facesOf(naive);
+        result.faces += naiveFaces.size();
+        result.mismatchedChunks += naiveFaces != facesOf(binary) ? 1 : 0;
+        result.chunks++;
+    });
+    ChunkMesh::setMode(previousMode);
+
+    if (result.chunks > 0) {
+        result.naiveMs = std::chrono::duration<double, std::milli>(naiveTime).count() / double(result.chunks);
+        result.binaryMs = std::chrono::duration<double, std::milli>(binaryTime).count() / double(result.chunks);
+    }
+    return result;
+}
+
+std::vector<MeshBenchmark> ChunkManager::benchmarkMesh()
+{
+    auto results = std::vector<MeshBenchmark> {
+        { MeshingMode::Naive }, { MeshingMode::Binary }, { MeshingMode::Greedy },
+    };
+    std::vector<std::size_t> largestMesh(results.size()); // In faces
+    const auto previousMode = ChunkMesh::mode();
+    forEachBenchmarkChunk([&](Engine::Chunk& chunk) {
+        for (std::size_t i = 0; i < results.size(); i++) {
+            auto& result = results[i];
+            ChunkMesh::setMode(result.mode);
+            ChunkMesh mesh(&chunk);
+            mesh.regenerate();
+
+            std::size_t faces = 0;
+            for (const auto& slot : mesh.layout()) {
+                faces += slot.count / 4;
+            }
+            result.faces += double(faces);
+            result.uploadedVertices += double(mesh.vertices().size());
+            largestMesh[i] = std::max(largestMesh[i], mesh.vertices().size() / 4);
+            result.chunks++;
+        }
+    });
+    ChunkMesh::setMode(previousMode);
+
+    for (std::size_t i = 0; i < results.size(); i++) {
+        auto& result = results[i];
+        const auto chunks = double(std::max<std::size_t>(result.chunks, 1));
+        result.faces /= chunks;
+        result.uploadedVertices /= chunks;
+        result.triangleVertices = result.faces * 6.0;
+        result.quadVertices = result.faces * 4.0;
+        result.indexBufferBytes = largestMesh[i] * 6 * sizeof(std::uint32_t);
+    }
+    return results;
+}
+
+BlockStorageBenchmark ChunkManager::benchmarkBlockStorage()
+{
+    using Clock = std::chrono::steady_clock;
+    const auto secondsSince = [](Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+    // Scattered like edits. An odd factor permutes the indices modulo a power of two.
+    static_assert((ChunkData::BLOCKS & (ChunkData::BLOCKS - 1)) == 0);
+    const auto indexAt = [](std::size_t i) {
+        return (i * 0x9E3779B1u) & std::size_t(ChunkData::BLOCKS - 1);
+    };
+
+    BlockStorageBenchmark result;
+    double paletteGetSeconds = 0.0;
+    double flatGetSeconds = 0.0;
+    double paletteSetSeconds = 0.0;
+    double flatSetSeconds = 0.0;
+    std::vector<Engine::BlockType> blocks(ChunkData::BLOCKS);
+    std::vector<Engine::BlockType> flat(ChunkData::BLOCKS);
+    forEachBenchmarkChunk([&](Engine::Chunk& chunk) {
+        for (auto z = 0; z < ChunkData::BLOCKS_Z; z++) {
+            for (auto y = 0; y < ChunkData::BLOCKS_Y; y++) {
+                for (auto x = 0; x < ChunkData::BLOCKS_X; x++) {
+                    blocks[std::size_t(x + ChunkData::BLOCKS_X * (y + ChunkData::BLOCKS_Y * z))] = chunk.get(x, y, z);
+                }
+            }
+        }
+
+        Engine::BlockStorage storage(ChunkData::BLOCKS, Engine::BlockType::AIR);
+        auto start = Clock::now();
+        for (std::size_t i = 0; i < blocks.size(); i++) {
+            storage.set(indexAt(i), blocks[indexAt(i)]);
+        }
+        paletteSetSeconds += secondsSince(start);
+        start = Clock::now();
+        for (std::size_t i = 0; i < blocks.size(); i++) {
+            flat[indexAt(i)] = blocks[indexAt(i)];
+        }
+        flatSetSeconds += secondsSince(start);
+
+        // Summed, so the reads can't be optimized away
+        std::size_t paletteSum = 0;
+        std::size_t flatSum = 0;
+        start = Clock::now();
+        for (std::size_t i = 0; i < blocks.size(); i++) {
+            paletteSum += std::size_t(storage.get(indexAt(i)));
+        }
+        paletteGetSeconds += secondsSince(start);
+        start = Clock::now();
+        for (std::size_t i = 0; i < blocks.size(); i++) {
+            flatSum += std::size_t(flat[indexAt(i)]);
+        }
+        flatGetSeconds += secondsSince(start);
+
+        if (paletteSum != flatSum) {
+            for (std::size_t i = 0; i < blocks.size(); i++) {
+                result.mismatches += storage.get(i) != flat[i] ? 1 : 0;
+            }
+        }
+        result.paletteBytes += chunk.blockMemoryUsage();
+        result.flatBytes += ChunkData::BLOCKS * sizeof(Engine::BlockType);
+        result.chunks++;
+    });
+
+    const auto accesses = double(result.chunks * ChunkData::BLOCKS);
+    result.paletteGetsPerSecond = accesses / paletteGetSeconds;
+    result.flatGetsPerSecond = accesses / flatGetSeconds;
+    result.paletteSetsPerSecond = accesses / paletteSetSeconds;
+    result.flatSetsPerSecond = accesses / flatSetSeconds;
+    return result;
+}
+
+ChunkStats ChunkManager::stressRenderList(std::chrono::milliseconds duration)
+{
+    ChunkManager manager(0);
+    manager.sourceChunk.set({ 16, 1, 16 });
+
+    // Walks the origin around a few chunks and digs next to it, so chunks keep being loaded,
+    // unloaded and remeshed
+    std::atomic<bool> stopped = false;
+    std::thread player([&manager, &stopped]() {
+        const auto extents = glm::ivec3{ ChunkData::BLOCKS_X, ChunkData::BLOCKS_Y, ChunkData::BLOCKS_Z };
+        for (auto step = 0; !stopped; step++) {
+            const auto origin = glm::ivec3{ 16 + step % 3, 1, 16 + step / 3 % 3 };
+            manager.sourceChunk.set(origin);
+            manager.setBlock(origin * extents + glm::ivec3{ step % ChunkData::BLOCKS_X, 0, 0 }, Engine::BlockType::AIR);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+
+    // Counted rather than asserted, so release builds check the lists as well
+    std::size_t mismatches = 0;
+    const auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end) {
+        // Everything the render thread reads of a chunk, except for its GL objects
+        const auto& renderList = manager.acquireRenderList();
+        std::size_t drawnVertices = 0;
+        for (const auto& [index, chunk] : renderList.chunks) {
+            if (renderList.at(index) != chunk || chunk->pos() != ChunkIndex{ index }.toWorldPos()) {
+                mismatches++;
+            }
+            drawnVertices += chunk->vertexCount() + chunk->uploadedDetail().lod;
+        }
+        manager.m_lastFrameDrawnVertices = drawnVertices;
+        // Without a GL context there is nothing to upload the meshes to
+        std::unique_lock<std::mutex> lck(manager.m_completedMeshesMutex);
+        manager.m_completedMeshes.clear();
+    }
+    stopped = true;
+    player.join();
+
+    auto stats = manager.stats();
+    stats.renderListMismatches = mismatches;
+    return stats;
 }
 
 bool ChunkManager::isWithinViewDistance(const ChunkIndex& chunk, const ChunkIndex& playerChunk) const
@@ -204,6 +597,12 @@ bool ChunkManager::isWithinViewDistance(const ChunkIndex& chunk, const ChunkInde
     return isWithinViewDistance(chunkDiff);
 }
 
+bool ChunkManager::isColumnWithinViewDistance(const glm::ivec2& column, const glm::ivec2& originColumn) const
+{
+    const auto offset = column - originColumn;
+    return isWithinViewDistance(glm::ivec3{ offset.x, 0, offset.y });
+}
+
 bool ChunkManager::isWithinViewDistance(const glm::ivec3& offset) const
 {
     return (
@@ -215,88 +614,791 @@ bool ChunkManager::isWithinViewDistance(const glm::ivec3& offset) const
 
 Engine::Chunk* ChunkManager::chunkAt(const ChunkIndex& index) const
 {
-    std::unique_lock<std::mutex> lck(m_chunksMutex);
-    auto hash = std::hash<glm::ivec3>{}(index.data());
-    auto it = m_chunks.find(hash);
-    return it == m_chunks.end() ? nullptr : (*it).second.get();
+    auto lck = lockChunks();
+    return m_chunks.at(index);
+}
+
+std::unique_lock<std::mutex> ChunkManager::lockChunks() const
+{
+    std::unique_lock<std::mutex> lck(m_chunksMutex, std::try_to_lock);
+    if (!lck.owns_lock()) {
+        m_chunksMutexContentions++;
+        lck.lock();
+    }
+    return lck;
+}
+
+Engine::Chunk* RenderList::at(const glm::ivec3& index) const
+{
+    const auto it = std::lower_bound(chunks.begin(), chunks.end(), index, [](const auto& entry, const glm::ivec3& value) {
+        return std::tie(entry.first.x, entry.first.y, entry.first.z) < std::tie(value.x, value.y, value.z);
+    });
+    return it != chunks.end() && it->first == index ? it->second : nullptr;
+}
+
+void ChunkManager::publishRenderList(std::vector<std::unique_ptr<Engine::Chunk>> unloaded)
+{
+    auto renderList = std::make_unique<RenderList>();
+    renderList->epoch = m_latestRenderList->epoch + 1;
+    renderList->chunks.reserve(m_chunks.size());
+    m_chunks.forEach([&renderList](const ChunkIndex& index, Engine::Chunk& chunk) {
+        renderList->chunks.emplace_back(index.data(), &chunk);
+    });
+    std::sort(renderList->chunks.begin(), renderList->chunks.end(), [](const auto& a, const auto& b) {
+        return std::tie(a.first.x, a.first.y, a.first.z) < std::tie(b.first.x, b.first.y, b.first.z);
+    });
+    m_retiredChunks += unloaded.size();
+    renderList->unloaded = std::move(unloaded);
+
+    // The render thread may still use the previous list, it is only freed once the render thread moved on
+    renderList->previous = std::move(m_latestRenderList);
+    m_latestRenderList = std::move(renderList);
+    m_renderList.store(m_latestRenderList.get(), std::memory_order_release);
+}
+
+const RenderList& ChunkManager::acquireRenderList()
+{
+    auto& renderList = *m_renderList.load(std::memory_order_acquire);
+
+    // Only the render thread frees lists and it only uses the latest one, so no one refers to the
+    // lists before it anymore. The chunk manager thread never touches a list once it published a later one.
+    auto stale = std::move(renderList.previous);
+    for (auto list = stale.get(); list; list = list->previous.get()) {
+        m_retiredChunks -= list->unloaded.size();
+    }
+    return renderList;
+}
+
+RenderList::~RenderList()
+{
+    // One by one, the chain of lists before this one gets long if no frame is rendered for a while
+    auto stale = std::move(previous);
+    while (stale) {
+        stale = std::move(stale->previous);
+    }
 }
 
 void ChunkManager::renderChunks(const glm::vec3& playerPos, const Engine::Shader& shader, const glm::mat4& viewProjectionMatrix)
 {
-    std::unique_lock<std::mutex> lck(m_chunksMutex);
-    for (auto& [key, chunk] : m_chunks)
+    std::vector<CompletedMesh> completedMeshes;
     {
+        std::unique_lock<std::mutex> lck(m_completedMeshesMutex);
+        completedMeshes.swap(m_completedMeshes);
+    }
+
+    std::sort(completedMeshes.begin(), completedMeshes.end(), [](const CompletedMesh& a, const CompletedMesh& b) {
+        return a.sequence < b.sequence;
+    });
+
+    // Acquiring the list frees the chunks unloaded since the last frame, whose buffers can be reused right away
+    const auto& renderList = acquireRenderList();
+    Engine::GpuBufferPool::instance().collect();
+    for (auto& completed : completedMeshes) {
+        // A complete mesh replaces every pending older mesh or patch of the same chunk.
+        // Patches of different sections all have to be applied.
+        if (completed.mesh->patchedSections() == 0) {
+            const auto isReplaced = [&completed](const CompletedMesh& mesh) {
+                return mesh.chunkIndex == completed.chunkIndex && mesh.sequence < completed.sequence;
+            };
+            for (const auto& pending : m_pendingUploads) {
+                if (isReplaced(pending) && pending.editTime && (!completed.editTime || *pending.editTime < *completed.editTime)) {
+                    completed.editTime = pending.editTime;
+                }
+            }
+            m_pendingUploads.erase(std::remove_if(m_pendingUploads.begin(), m_pendingUploads.end(), isReplaced), m_pendingUploads.end());
+        }
+        m_pendingUploads.push_back(std::move(completed));
+    }
+    uploadPendingMeshes(playerPos, renderList);
+
+    std::size_t drawnVertices = 0;
+    for (const auto& [index, chunk] : renderList.chunks) {
         shader.setUniform("modelViewProjectionMatrix", viewProjectionMatrix * chunk->getModelWorldMatrix());
-        chunk->render();
+        drawnVertices += chunk->render(playerPos);
     }
+    m_lastFrameDrawnVertices = drawnVertices;
 }
 
-void ChunkManager::ensureChunkAtIndex(const ChunkIndex& index)
+void ChunkManager::uploadPendingMeshes(const glm::vec3& playerPos, const RenderList& renderList)
 {
-    auto chunk = chunkAt(index);
-    if (!chunk) {
-        addChunkAt(index, m_texture);
+    // The chunk may have been unloaded while it was meshed, or not be published yet
+    m_pendingUploads.erase(std::remove_if(m_pendingUploads.begin(), m_pendingUploads.end(), [&renderList](const CompletedMesh& mesh) {
+        return !renderList.at(mesh.chunkIndex);
+    }), m_pendingUploads.end());
+
+    // Meshes for edits go first and ignore the budget, along with the older meshes of the same
+    // chunk, since the meshes of one chunk have to be uploaded in order
+    std::unordered_map<glm::ivec3, std::uint64_t> latestEdits;
+    for (const auto& mesh : m_pendingUploads) {
+        if (mesh.editTime) {
+            auto& latest = latestEdits[mesh.chunkIndex];
+            latest = std::max(latest, mesh.sequence);
+        }
+    }
+    const auto isUrgent = [&latestEdits](const CompletedMesh& mesh) {
+        const auto it = latestEdits.find(mesh.chunkIndex);
+        return it != latestEdits.end() && mesh.sequence <= it->second;
+    };
+
+    // Then the meshes closest to the player. Sorted in reverse, so the next mesh can be taken from the back.
+    const auto uploadOrder = [&renderList, &playerPos, &isUrgent](const CompletedMesh& mesh) {
+        const auto offset = glm::vec3(renderList.at(mesh.chunkIndex)->getCenterPos()) - playerPos;
+        return std::tuple{ !isUrgent(mesh), glm::dot(offset, offset), mesh.sequence };
+    };
+    std::sort(m_pendingUploads.begin(), m_pendingUploads.end(), [&uploadOrder](const CompletedMesh& a, const CompletedMesh& b) {
+        return uploadOrder(a) > uploadOrder(b);
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    std::size_t bytes = 0;
+    std::size_t uploads = 0;
+    while (!m_pendingUploads.empty()) {
+        auto& next = m_pendingUploads.back();
+        const auto size = next.mesh->vertices().size() * sizeof(Vertex);
+        const auto elapsedMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!isUrgent(next) && uploads > 0 && (bytes + size > m_uploadBudget.bytesPerFrame || elapsedMs >= m_uploadBudget.millisecondsPerFrame)) {
+            break;
+        }
+
+        auto& chunk = *renderList.at(next.chunkIndex);
+        const auto isPatch = next.mesh->patchedSections() != 0;
+        const auto uploaded = isPatch ? chunk.patchMeshData(*next.mesh, next.sequence) : chunk.addMeshData(*next.mesh, next.sequence);
+        if (uploaded.status == Engine::UploadStatus::DoesNotFit || uploaded.status == Engine::UploadStatus::Outdated) {
+            // The patch does not fit into the chunk's mesh, or the mesh misses a patch shown already.
+            // Mesh the whole chunk again, with new spare capacity.
+            m_thread->pushEvent(std::make_unique<MeshChunkEvent>(ChunkIndex{ next.chunkIndex }, next.editTime));
+        }
+        else if (uploaded.status == Engine::UploadStatus::Uploaded && next.editTime) {
+            const auto latencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - *next.editTime).count();
+            (isPatch ? m_patchedEdits : m_remeshedEdits)++;
+            (isPatch ? m_patchLatencyMs : m_remeshLatencyMs) += latencyMs;
+        }
+        bytes += uploaded.bytes;
+        uploads++;
+        m_pendingUploads.pop_back();
+    }
+
+    m_lastFrameUploadedBytes = bytes;
+    m_uploadedBytes += bytes;
+}
+
+void ChunkManager::setUploadBudget(const UploadBudget& budget)
+{
+    m_uploadBudget = budget;
+}
+
+ChunkStats ChunkManager::stats() const
+{
+    ChunkStats result;
+    const auto& renderList = *m_renderList.load(std::memory_order_acquire);
+    result.chunks = renderList.chunks.size();
+    {
+        // Only held exclusively for short changes of loaded chunks, never while generating or meshing
+        std::shared_lock<std::shared_mutex> blocksLock(m_blocksMutex);
+        for (const auto& [index, chunk] : renderList.chunks) {
+            result.blockMemory += chunk->blockMemoryUsage();
+            result.uniformChunks += chunk->uniformType().has_value() ? 1 : 0;
+            result.allocatedSections += chunk->allocatedSections();
+        }
+    }
+    for (const auto& [index, chunk] : renderList.chunks) {
+        result.vertices += chunk->vertexCount();
+        // The default detail of chunks still waiting for their first mesh would count as full detail
+        if (chunk->hasUploadedMesh()) {
+            result.lodChunks.at(chunk->uploadedDetail().lod)++;
+        }
+    }
+    result.renderListEpoch = renderList.epoch;
+    result.retiredChunks = m_retiredChunks;
+    result.chunksMutexContentions = m_chunksMutexContentions;
+    result.uploadedBytes = m_uploadedBytes;
+    result.pendingUploads = m_pendingUploads.size();
+    result.lastFrameUploadedBytes = m_lastFrameUploadedBytes;
+    result.lastFrameDrawnVertices = m_lastFrameDrawnVertices;
+    result.patchedEdits = m_patchedEdits;
+    result.remeshedEdits = m_remeshedEdits;
+    result.patchLatencyMs = m_patchedEdits > 0 ? m_patchLatencyMs / double(m_patchedEdits) : 0.0;
+    result.remeshLatencyMs = m_remeshedEdits > 0 ? m_remeshLatencyMs / double(m_remeshedEdits) : 0.0;
+    const auto meshMemory = ChunkMesh::memoryStats();
+    result.meshMemory = meshMemory.current;
+    result.peakMeshMemory = meshMemory.peak;
+    if (const auto generatedChunks = m_generatedChunks.load(); generatedChunks > 0) {
+        result.averageGenerationMs = double(m_generationMicroseconds.load()) / 1000.0 / double(generatedChunks);
+        result.averageDensityEvaluations = double(m_densityEvaluations.load()) / double(generatedChunks);
+    }
+    result.airAboveMaxHeight = m_airAboveMaxHeight;
+    result.airAboveSurface = m_airAboveSurface;
+    result.sampledChunks = m_sampledChunks;
+    if (result.sampledChunks > 0) {
+        result.averageSampledLayers = double(m_sampledLayers.load()) / double(result.sampledChunks);
+    }
+    result.comparedBlocks = m_comparedBlocks;
+    if (result.comparedBlocks > 0) {
+        result.densityDifferenceRate = double(m_differentBlocks.load()) / double(result.comparedBlocks);
+    }
+    if (const auto meshedChunks = m_meshedChunks.load(); meshedChunks > 0) {
+        result.averageMeshingMs = double(m_meshingMicroseconds.load()) / 1000.0 / double(meshedChunks);
+    }
+    return result;
+}
+
+std::unique_ptr<Engine::Chunk> ChunkManager::generateChunk(const ChunkIndex& index, ColumnSurface& surface, const DensitySampling& sampling)
+{
+    // Chunks below the band of grass and dirt are all stone and air, so they skip the surface above them
+    if (index.toWorldPos().y + ChunkData::BLOCKS_Y > MIN_GRASS_Y - DIRT_DEPTH) {
+        while (surface.chunkY > index.data().y + 1) {
+            generateSurface(ChunkIndex{ { index.data().x, surface.chunkY - 1, index.data().z } }, surface, sampling);
+        }
+    }
+
+    const auto generationStart = std::chrono::steady_clock::now();
+    auto chunk = std::make_unique<Engine::Chunk>(index.toWorldPos(), m_texture, Engine::BlockType::AIR);
+    const auto terrain = classifyTerrain(index);
+    switch (terrain.kind) {
+    case TerrainClass::AboveMaxHeight:
+        m_airAboveMaxHeight++;
+        break;
+    case TerrainClass::AboveSurface:
+        m_airAboveSurface++;
+        break;
+    case TerrainClass::Sampled:
+        m_densityEvaluations += generateTerrain(chunk.get(), index, terrain.top, sampling, surface.grassY);
+        m_sampledChunks++;
+        m_sampledLayers += std::size_t(terrain.top + 1);
+        break;
+    }
+    surface.chunkY = index.data().y;
+
+    m_generationMicroseconds += std::size_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - generationStart).count());
+    m_generatedChunks++;
+    return chunk;
+}
+
+void ChunkManager::generateSurface(const ChunkIndex& index, ColumnSurface& surface, const DensitySampling& sampling)
+{
+    if (const auto terrain = classifyTerrain(index); terrain.kind == TerrainClass::Sampled) {
+        generateTerrain(nullptr, index, terrain.top, sampling, surface.grassY);
+    }
+    surface.chunkY = index.data().y;
+}
+
+void ChunkManager::generateColumn(const std::vector<ChunkIndex>& indices, DensitySampling sampling)
+{
+    const auto column = glm::ivec2{ indices.front().data().x, indices.front().data().z };
+    auto surface = columnSurfaceAbove(indices.front(), sampling);
+    GeneratedChunks chunks;
+    chunks.reserve(indices.size());
+    for (const auto& index : indices) {
+        chunks.emplace_back(index, generateChunk(index, surface, sampling));
+    }
+    storeColumnSurface(column, std::move(surface));
+    // One event for the whole column, so the render list is published once per column
+    m_thread->pushEvent(std::make_unique<ColumnGeneratedEvent>(std::move(chunks)));
+}
+
+ColumnSurface ChunkManager::columnTop(const glm::ivec2& column, const DensitySampling& sampling)
+{
+    // Blocks above the highest point of the heightmap are air
+    const auto heightmap = heightmapAt(column);
+    const auto surface = *std::max_element(heightmap->begin(), heightmap->end());
+    return { floorDiv(surface, ChunkData::BLOCKS_Y) + 1, sampling, std::vector<int>(heightmap->size(), ColumnSurface::NONE) };
+}
+
+ColumnSurface ChunkManager::columnSurfaceAbove(const ChunkIndex& index, const DensitySampling& sampling)
+{
+    const auto column = glm::ivec2{ index.data().x, index.data().z };
+    {
+        std::unique_lock<std::mutex> lck(m_columnSurfacesMutex);
+        if (const auto it = m_columnSurfaces.find(column); it != m_columnSurfaces.end()
+            && it->second.sampling == sampling && it->second.chunkY > index.data().y) {
+            return it->second;
+        }
+    }
+    auto surface = columnTop(column, sampling);
+    surface.chunkY = std::max(surface.chunkY, index.data().y + 1);
+    return surface;
+}
+
+void ChunkManager::storeColumnSurface(const glm::ivec2& column, ColumnSurface surface)
+{
+    // Like the heightmaps, never keep the surface of a column the origin moved away from meanwhile
+    std::unique_lock<std::mutex> lck(m_columnSurfacesMutex);
+    if (m_columnSurfacesOrigin && !isColumnWithinViewDistance(column, *m_columnSurfacesOrigin)) {
+        return;
+    }
+    auto [it, inserted] = m_columnSurfaces.try_emplace(column, surface);
+    if (!inserted && (it->second.sampling != surface.sampling || surface.chunkY < it->second.chunkY)) {
+        it->second = std::move(surface);
+    }
+}
+
+void ChunkManager::requestColumn(const glm::ivec3& column)
+{
+    // One job for the whole column, from the top down, since every chunk needs the surface of the
+    // chunks above it. Loaded chunks in between are generated again for their surface only, unless
+    // a previous job cached it.
+    std::vector<ChunkIndex> indices;
+    for (auto yIndex = viewDistanceInChunks.y; yIndex > -viewDistanceInChunks.y; yIndex--) {
+        const auto index = ChunkIndex{ column + glm::ivec3{0, yIndex, 0} };
+        if (!chunkAt(index) && m_pendingChunks.insert(index.data()).second) {
+            indices.push_back(index);
+        }
+    }
+    if (!indices.empty()) {
+        m_jobs.submit([this, indices = std::move(indices), sampling = m_densitySampling]() {
+            generateColumn(indices, sampling);
+        });
+    }
+}
+
+void ChunkManager::insertChunks(GeneratedChunks chunks)
+{
+    // Neighbors meshed before a chunk existed treated it as air. An all-air chunk changes nothing
+    // for them and an all-air neighbor has no faces to hide.
+    std::vector<ChunkIndex> remeshed;
+    {
+        std::unique_lock<std::shared_mutex> blocksLock(m_blocksMutex);
+        auto lck = lockChunks();
+        for (auto& [index, chunk] : chunks) {
+            const auto isAir = chunk->uniformType() == Engine::BlockType::AIR;
+            chunk->setLod(lodAt(index));
+            const auto neighbors = m_chunks.neighbors(index);
+            for (std::size_t dir = 0; dir < neighbors.size(); dir++) {
+                auto neighbor = neighbors[dir];
+                chunk->setNeighbor(neighbor, Engine::Direction(dir));
+                if (neighbor) {
+                    neighbor->setNeighbor(chunk.get(), opposite(Engine::Direction(dir)));
+                    if (!isAir && neighbor->uniformType() != Engine::BlockType::AIR) {
+                        remeshed.push_back(ChunkIndex{ index.data() + neighborOffsets[dir] });
+                    }
+                }
+            }
+            remeshed.push_back(index);
+            m_chunks.insert(index, std::move(chunk));
+        }
+    }
+    // Meshes of chunks missing in the render list are dropped, so publish before meshing
+    publishRenderList();
+
+    for (const auto& index : remeshed) {
+        requestRemesh(index);
+    }
+    m_insertedChunks += chunks.size();
+}
+
+void ChunkManager::requestRemesh(const ChunkIndex& index, EditTime editTime)
+{
+    // A chunk already waiting for its meshing job is meshed with the latest blocks anyway
+    {
+        std::unique_lock<std::mutex> lck(m_remeshQueueMutex);
+        if (!m_remeshQueue.insert(index.data()).second) {
+            return;
+        }
+    }
+    m_jobs.submit([this, index, editTime]() {
+        meshChunk(index, editTime);
+    });
+}
+
+std::shared_ptr<const std::vector<int>> ChunkManager::heightmapAt(const glm::ivec2& column)
+{
+    {
+        std::unique_lock<std::mutex> lck(m_heightmapsMutex);
+        if (const auto it = m_heightmaps.find(column); it != m_heightmaps.end()) {
+            return it->second;
+        }
+    }
+
+    // Computed without holding the lock. Should two jobs compute the same heightmap, the
+    // first one is kept.
+    const auto heightFreq = 256.0f;
+    const auto worldX = column.x * ChunkData::BLOCKS_X;
+    const auto worldZ = column.y * ChunkData::BLOCKS_Z;
+    auto heightmap = std::make_shared<std::vector<int>>(ChunkData::BLOCKS_X * ChunkData::BLOCKS_Z);
+    std::array<float, ChunkData::BLOCKS_X> noiseX, noiseZ, noise;
+    for (auto a = 0; a < ChunkData::BLOCKS_X; a++) {
+        noiseX[std::size_t(a)] = float(worldX + a) / heightFreq;
+    }
+    for (auto b = 0; b < ChunkData::BLOCKS_Z; b++) {
+        noiseZ.fill(float(worldZ + b) / heightFreq);
+        m_batchNoise.accumulatedOctaveNoise2D_0_1(noiseX, noiseZ, 5, noise);
+        for (auto a = 0; a < ChunkData::BLOCKS_X; a++) {
+            (*heightmap)[std::size_t(a + ChunkData::BLOCKS_X * b)] = int(std::floor(std::pow(noise[std::size_t(a)], 2) * MAX_TERRAIN_HEIGHT));
+        }
+    }
+
+    // A job may still run for a column the origin has moved away from since, which would stay
+    // cached until the next move
+    std::unique_lock<std::mutex> lck(m_heightmapsMutex);
+    if (m_heightmapsOrigin && !isColumnWithinViewDistance(column, *m_heightmapsOrigin)) {
+        return heightmap;
+    }
+    return m_heightmaps.try_emplace(column, std::move(heightmap)).first->second;
+}
+
+TerrainClass ChunkManager::classifyTerrain(const ChunkIndex& index)
+{
+    // Every block above the highest surface the height function can produce is air, no matter
+    // the column. Those chunks don't need their heightmap.
+    const auto worldY = index.toWorldPos().y;
+    if (worldY > MAX_TERRAIN_HEIGHT) {
+        return { TerrainClass::AboveMaxHeight };
+    }
+
+    // Otherwise only blocks up to the highest surface of the chunk's columns can be solid. The
+    // density spans [0, 1] around its threshold, so it proves no chunk below that all solid.
+    const auto heightmap = heightmapAt({ index.data().x, index.data().z });
+    const auto surface = *std::max_element(heightmap->begin(), heightmap->end());
+    if (surface < worldY) {
+        return { TerrainClass::AboveSurface };
     }
+    return { TerrainClass::Sampled, std::min(surface - worldY, ChunkData::BLOCKS_Y - 1) };
 }
 
-void ChunkManager::addChunkAt(const ChunkIndex& index, GLuint texture)
+std::size_t ChunkManager::generateTerrain(Engine::Chunk* chunk, const ChunkIndex& index, int top, const DensitySampling& sampling,
+                                          std::span<int> grassY)
 {
     const auto worldPos = index.toWorldPos();
-    auto chunk = std::make_unique<Engine::Chunk>(worldPos, texture, Engine::BlockType::AIR);
-    const auto chunkAbove = chunkAt(ChunkIndex{ index.data() + glm::ivec3{0,1,0} });
+    const auto heightmapOwner = heightmapAt({ index.data().x, index.data().z });
+    const auto& heightmap = *heightmapOwner;
+    const auto densityFreq = 32.0f;
+    const auto densityThreshold = 0.7f;
+    const auto startPosAt = [&](int a, int b) {
+        auto heightValue = heightmap[std::size_t(a + ChunkData::BLOCKS_X * b)];
+        return heightValue >= (worldPos.y + ChunkData::BLOCKS_Y) ? ChunkData::BLOCKS_Y - 1 : heightValue - worldPos.y;
+    };
+
+    std::array<float, ChunkData::BLOCKS_Y> densityX, densityY, densityZ, density;
+    std::size_t evaluations = 0;
+    // Evaluates the density at x, z of the first count heights in densityY and stores it in density
+    const auto evaluateColumn = [&](float x, float z, std::size_t count) {
+        std::fill_n(densityX.begin(), count, x);
+        std::fill_n(densityZ.begin(), count, z);
+        m_batchNoise.accumulatedOctaveNoise3D_0_1(std::span(densityX).first(count), std::span(densityY).first(count),
+                                                  std::span(densityZ).first(count), 2, std::span(density).first(count));
+        evaluations += count;
+    };
+
+    // The density on a lattice with points every spacing blocks, including the far side of the
+    // chunk, up to the top
+    const auto spacing = sampling.spacing;
+    assert(spacing >= 1 && ChunkData::BLOCKS_X % spacing == 0 && ChunkData::BLOCKS_Y % spacing == 0);
+    const auto latticeXZ = ChunkData::BLOCKS_X / spacing + 1;
+    const auto latticeY = std::min(top / spacing + 2, ChunkData::BLOCKS_Y / spacing + 1);
+    thread_local std::vector<float> s_lattice;
+    if (spacing > 1) {
+        s_lattice.resize(std::size_t(latticeXZ * latticeXZ * latticeY));
+        for (auto j = 0; j < latticeY; j++) {
+            densityY[std::size_t(j)] = float(worldPos.y + j * spacing) / densityFreq;
+        }
+        for (auto k = 0; k < latticeXZ; k++) {
+            for (auto i = 0; i < latticeXZ; i++) {
+                evaluateColumn(float(worldPos.x + i * spacing) / densityFreq, float(worldPos.z + k * spacing) / densityFreq, std::size_t(latticeY));
+                std::copy_n(density.begin(), latticeY, s_lattice.begin() + std::ptrdiff_t((i + latticeXZ * k) * latticeY));
+            }
+        }
+    }
+    const auto latticeColumn = [&](int i, int k) {
+        return &s_lattice[std::size_t((i + latticeXZ * k) * latticeY)];
+    };
+
+    std::array<float, ChunkData::BLOCKS_Y> columnDensity;
+    std::array<float, ChunkData::BLOCKS_Y / 2 + 1> latticeDensity;
+    std::array<int, ChunkData::BLOCKS_Y> refined;
     for (auto a = 0; a < ChunkData::BLOCKS_X; a++) {
         for (auto b = 0; b < ChunkData::BLOCKS_Z; b++) {
-            const auto heightFreq = 256.0f;
-            const auto densityFreq = 32.0f;
-            const auto maxHeight = 200;
-            auto heightValue = int(std::floor(std::pow(m_perlinNoise.accumulatedOctaveNoise2D_0_1(float(worldPos.x + a) / heightFreq, float(worldPos.z + b) / heightFreq, 5), 2) * maxHeight));
-            auto startPos = heightValue >= (worldPos.y + ChunkData::BLOCKS_Y) ? ChunkData::BLOCKS_Y - 1 : heightValue - worldPos.y;
-            auto firstBlock = chunkAbove ? (chunkAbove->get(a, 0, b) == Engine::BlockType::AIR ? std::nullopt : std::make_optional(std::numeric_limits<int>::max())) : std::nullopt;
+            auto startPos = startPosAt(a, b);
+            auto& firstBlock = grassY[std::size_t(a + ChunkData::BLOCKS_X * b)];
+            // Without a chunk only columns still looking for their grass need any density
+            if (startPos < 0 || (!chunk && firstBlock != ColumnSurface::NONE)) {
+                continue;
+            }
+
+            const auto count = std::size_t(startPos + 1);
+            const auto x = float(worldPos.x + a) / densityFreq;
+            const auto z = float(worldPos.z + b) / densityFreq;
+            if (spacing <= 1) {
+                // The density of the whole column below the surface in one batch
+                for (std::size_t c = 0; c < count; c++) {
+                    densityY[c] = float(worldPos.y + int(c)) / densityFreq;
+                }
+                evaluateColumn(x, z, count);
+                std::copy_n(density.begin(), count, columnDensity.begin());
+            }
+            else {
+                // Interpolate between the four lattice columns around this one, then along y.
+                // Blocks close to the threshold could flip, so those are evaluated exactly.
+                const auto i = a / spacing;
+                const auto k = b / spacing;
+                const auto tx = float(a % spacing) / float(spacing);
+                const auto tz = float(b % spacing) / float(spacing);
+                const auto* const c00 = latticeColumn(i, k);
+                const auto* const c10 = latticeColumn(i + 1, k);
+                const auto* const c01 = latticeColumn(i, k + 1);
+                const auto* const c11 = latticeColumn(i + 1, k + 1);
+                for (auto j = 0; j <= startPos / spacing + 1 && j < latticeY; j++) {
+                    const auto near = c00[j] + tx * (c10[j] - c00[j]);
+                    const auto far = c01[j] + tx * (c11[j] - c01[j]);
+                    latticeDensity[std::size_t(j)] = near + tz * (far - near);
+                }
+
+                std::size_t refinedCount = 0;
+                for (auto c = 0; c <= startPos; c++) {
+                    const auto j = std::size_t(c / spacing);
+                    const auto ty = float(c % spacing) / float(spacing);
+                    const auto value = ty == 0.0f ? latticeDensity[j] : latticeDensity[j] + ty * (latticeDensity[j + 1] - latticeDensity[j]);
+                    columnDensity[std::size_t(c)] = value;
+                    if (std::abs(value - densityThreshold) < sampling.refineMargin) {
+                        densityY[refinedCount] = float(worldPos.y + c) / densityFreq;
+                        refined[refinedCount++] = c;
+                    }
+                }
+                if (refinedCount > 0) {
+                    evaluateColumn(x, z, refinedCount);
+                    for (std::size_t r = 0; r < refinedCount; r++) {
+                        columnDensity[std::size_t(refined[r])] = density[r];
+                    }
+                }
+            }
+
             for (auto c = startPos; c >= 0; c--) {
-                auto value = m_perlinNoise.accumulatedOctaveNoise3D_0_1(float(worldPos.x + a) / densityFreq, float(worldPos.y + c) / densityFreq, float(worldPos.z + b) / densityFreq, 2);
-                const auto addBlock = value < 0.7f;
+                const auto addBlock = columnDensity[std::size_t(c)] < densityThreshold;
                 if (!addBlock) {
                     continue;
                 }
 
                 auto blockType = Engine::BlockType::STONE;
-                if (!firstBlock.has_value() && (worldPos.y + c) >= 0) {
-                    firstBlock = c;
+                if (firstBlock == ColumnSurface::NONE && (worldPos.y + c) >= MIN_GRASS_Y) {
+                    firstBlock = worldPos.y + c;
                     blockType = Engine::BlockType::GRASS;
                 }
-                else if (firstBlock.has_value() && c > (*firstBlock - 3)) {
+                else if (firstBlock != ColumnSurface::NONE && worldPos.y + c >= firstBlock - DIRT_DEPTH) {
                     blockType = Engine::BlockType::DIRT;
                 }
+                if (!chunk) {
+                    if (blockType == Engine::BlockType::GRASS) {
+                        break;
+                    }
+                    continue;
+                }
                 chunk->set(a, c, b, blockType);
             }
         }
     }
+    return evaluations;
+}
+
+void ChunkManager::runDensityComparison()
+{
+    if (!m_playerChunk) {
+        return;
+    }
+
+    // Generate the chunks of the 3x3 columns around the player both ways and compare every block
+    std::size_t comparedBlocks = 0;
+    std::size_t differentBlocks = 0;
+    for (auto dx = -1; dx <= 1; dx++) {
+        for (auto dz = -1; dz <= 1; dz++) {
+            // Top-down from above the terrain, like the generation jobs, each way with its own surface
+            const auto column = m_playerChunk->data() + glm::ivec3{ dx, 0, dz };
+            const auto exactSampling = DensitySampling{ 1, 0.0f };
+            auto exactSurface = columnTop({ column.x, column.z }, exactSampling);
+            auto sampledSurface = exactSurface;
+            for (auto y = exactSurface.chunkY - 1; y > column.y - viewDistanceInChunks.y; y--) {
+                const auto index = ChunkIndex{ { column.x, y, column.z } };
+                const auto terrain = classifyTerrain(index);
+                if (terrain.kind != TerrainClass::Sampled) {
+                    continue; // All air either way
+                }
+                if (y > column.y + viewDistanceInChunks.y) {
+                    // Above the view, only generated for the surface
+                    generateTerrain(nullptr, index, terrain.top, exactSampling, exactSurface.grassY);
+                    generateTerrain(nullptr, index, terrain.top, m_densitySampling, sampledSurface.grassY);
+                    continue;
+                }
+                Engine::Chunk exact(index.toWorldPos(), m_texture, Engine::BlockType::AIR);
+                Engine::Chunk sampled(index.toWorldPos(), m_texture, Engine::BlockType::AIR);
+                generateTerrain(&exact, index, terrain.top, exactSampling, exactSurface.grassY);
+                generateTerrain(&sampled, index, terrain.top, m_densitySampling, sampledSurface.grassY);
+                for (auto z = 0; z < ChunkData::BLOCKS_Z; z++) {
+                    for (auto blockY = 0; blockY < ChunkData::BLOCKS_Y; blockY++) {
+                        for (auto x = 0; x < ChunkData::BLOCKS_X; x++) {
+                            differentBlocks += exact.get(x, blockY, z) != sampled.get(x, blockY, z) ? 1 : 0;
+                        }
+                    }
+                }
+                comparedBlocks += ChunkData::BLOCKS;
+            }
+        }
+    }
+    m_comparedBlocks = comparedBlocks;
+    m_differentBlocks = differentBlocks;
+}
+
+std::uint8_t ChunkManager::lodAt(const ChunkIndex& index) const
+{
+    if (!m_playerChunk) {
+        return 0;
+    }
+    const auto distance = glm::compMax(glm::abs(index.data() - m_playerChunk->data()));
+    if (distance >= m_lodRings.quarterDetail) {
+        return 2;
+    }
+    return distance >= m_lodRings.halfDetail ? 1 : 0;
+}
+
+void ChunkManager::updateLods()
+{
+    std::vector<glm::ivec3> changedChunks;
+    {
+        std::unique_lock<std::shared_mutex> blocksLock(m_blocksMutex);
+        m_chunks.forEach([this, &changedChunks](const ChunkIndex& index, Engine::Chunk& chunk) {
+            if (const auto lod = lodAt(index); lod != chunk.lod()) {
+                chunk.setLod(lod);
+                changedChunks.push_back(index.data());
+            }
+        });
+    }
+
+    for (const auto& index : changedChunks) {
+        requestRemesh(ChunkIndex{ index });
+        for (const auto& offset : neighborOffsets) {
+            if (chunkAt(ChunkIndex{ index + offset })) {
+                requestRemesh(ChunkIndex{ index + offset });
+            }
+        }
+    }
+}
+
+void ChunkManager::setLodRings(const LodRings& rings)
+{
+    m_thread->pushEvent(std::make_unique<LodRingsEvent>(rings));
+}
+
+void ChunkManager::setDensitySampling(const DensitySampling& sampling)
+{
+    // The lattice has to line up with the chunk borders, so round down to a divisor of the chunk size
+    auto clamped = sampling;
+    clamped.spacing = std::clamp(clamped.spacing, 1, ChunkData::BLOCKS_X);
+    while (ChunkData::BLOCKS_X % clamped.spacing != 0) {
+        clamped.spacing--;
+    }
+    m_thread->pushEvent(std::make_unique<DensitySamplingEvent>(clamped));
+}
 
-    auto lastZ = chunkAt(ChunkIndex{ index.data() + glm::ivec3(0,0,-1) });
+void ChunkManager::compareDensitySampling()
+{
+    m_thread->pushEvent(std::make_unique<CompareDensityEvent>());
+}
 
-    auto lastY = chunkAt(ChunkIndex{ index.data() + glm::ivec3(0,-1,0) });
+void ChunkManager::setBlock(const glm::ivec3& worldPos, Engine::BlockType type)
+{
+    m_thread->pushEvent(std::make_unique<SetBlockEvent>(worldPos, type));
+}
 
-    auto lastX = chunkAt(ChunkIndex{ index.data() + glm::ivec3(-1,0,0) });
+void ChunkManager::setIncrementalEdits(bool enabled)
+{
+    m_incrementalEdits = enabled;
+}
 
-    chunk->setNeighbor(lastX, Engine::Direction::NegX);
-    if (lastX) {
-        lastX->setNeighbor(chunk.get(), Engine::Direction::PlusX);
+void ChunkManager::applyBlockEdit(const glm::ivec3& worldPos, Engine::BlockType type, EditTime editTime)
+{
+    const auto extents = glm::ivec3{ ChunkData::BLOCKS_X, ChunkData::BLOCKS_Y, ChunkData::BLOCKS_Z };
+    const auto chunkIndexOf = [&extents](const glm::ivec3& pos) {
+        return glm::ivec3{ floorDiv(pos.x, extents.x), floorDiv(pos.y, extents.y), floorDiv(pos.z, extents.z) };
+    };
+
+    const auto index = chunkIndexOf(worldPos);
+    auto chunk = chunkAt(ChunkIndex{ index });
+    const auto blockPos = worldPos - index * extents;
+    if (!chunk || chunk->get(blockPos.x, blockPos.y, blockPos.z) == type) {
+        return;
     }
-    chunk->setNeighbor(lastY, Engine::Direction::NegY);
-    if (lastY) {
-        lastY->setNeighbor(chunk.get(), Engine::Direction::PlusY);
+    {
+        std::unique_lock<std::shared_mutex> blocksLock(m_blocksMutex);
+        chunk->set(blockPos.x, blockPos.y, blockPos.z, type);
     }
-    chunk->setNeighbor(lastZ, Engine::Direction::NegZ);
-    if (lastZ) {
-        lastZ->setNeighbor(chunk.get(), Engine::Direction::PlusZ);
+
+    // The faces of the block and of its six neighbors can change. Collect the sections holding
+    // them, which may lie in neighbor chunks.
+    std::vector<std::pair<glm::ivec3, std::uint64_t>> changedSections;
+    const auto addBlock = [&](const glm::ivec3& pos) {
+        const auto blockChunk = chunkIndexOf(pos);
+        const auto local = pos - blockChunk * extents;
+        constexpr auto extent = ChunkData::SECTION_EXTENT;
+        const auto section = local.x / extent + ChunkData::SECTIONS_X * (local.y / extent + ChunkData::SECTIONS_Y * (local.z / extent));
+        auto it = std::find_if(changedSections.begin(), changedSections.end(), [&blockChunk](const auto& entry) {
+            return entry.first == blockChunk;
+        });
+        if (it == changedSections.end()) {
+            it = changedSections.insert(changedSections.end(), { blockChunk, 0 });
+        }
+        it->second |= std::uint64_t{1} << section;
+    };
+    addBlock(worldPos);
+    for (const auto& offset : neighborOffsets) {
+        addBlock(worldPos + offset);
     }
 
-    chunk->regenerateMesh();
+    for (const auto& [chunkIndex, sections] : changedSections) {
+        const auto changedChunk = chunkAt(ChunkIndex{ chunkIndex });
+        if (!changedChunk) {
+            continue;
+        }
+        if (m_incrementalEdits && ChunkMesh::canPatch() && changedChunk->lod() == 0) {
+            meshSections(ChunkIndex{ chunkIndex }, sections, editTime);
+        }
+        else {
+            requestRemesh(ChunkIndex{ chunkIndex }, editTime);
+        }
+    }
+}
 
-    const auto hashed = std::hash<glm::ivec3>{}(index.data());
+void ChunkManager::meshChunk(const ChunkIndex& index, EditTime editTime)
+{
+    // Only average meshing times of the current mode
+    if (const auto mode = ChunkMesh::mode(); m_statsMeshingMode.exchange(mode) != mode) {
+        m_meshedChunks = 0;
+        m_meshingMicroseconds = 0;
+    }
+    const auto meshingStart = std::chrono::steady_clock::now();
 
+    // The sequence is taken along with the copy, so a mesh of older blocks never has a later one
+    std::unique_ptr<ChunkMesh> mesh;
+    std::uint64_t sequence = 0;
     {
-        std::unique_lock<std::mutex> lck(m_chunksMutex);
-        m_chunks[hashed] = std::move(chunk);
+        std::shared_lock<std::shared_mutex> blocksLock(m_blocksMutex);
+        {
+            std::unique_lock<std::mutex> lck(m_remeshQueueMutex);
+            m_remeshQueue.erase(index.data());
+        }
+        auto chunk = chunkAt(index);
+        if (!chunk) {
+            return;
+        }
+        mesh = std::make_unique<ChunkMesh>(chunk, chunk->meshDetail());
+        mesh->copyBlocks();
+        sequence = ++m_meshSequence;
     }
+
+    mesh->regenerate();
+    m_meshingMicroseconds += std::size_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - meshingStart).count());
+    m_meshedChunks++;
+
+    std::unique_lock<std::mutex> lck(m_completedMeshesMutex);
+    m_completedMeshes.push_back({ index.data(), sequence, std::move(mesh), editTime });
+}
+
+void ChunkManager::meshSections(const ChunkIndex& index, std::uint64_t sections, EditTime editTime)
+{
+    auto chunk = chunkAt(index);
+    if (!chunk) {
+        return;
+    }
+
+    auto mesh = std::make_unique<ChunkMesh>(chunk, chunk->meshDetail());
+    mesh->regenerateSections(sections);
+
+    std::unique_lock<std::mutex> lck(m_completedMeshesMutex);
+    m_completedMeshes.push_back({ index.data(), ++m_meshSequence, std::move(mesh), editTime });
 }
@@ -2,10 +2,28 @@
 
 #include <gl/glew.h>
 #include <glm/fwd.hpp>
+#include <glm/gtx/hash.hpp>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <shared_mutex>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
+#include "BatchNoise.h"
+#include "ChunkGrid.h"
+#include "ChunkMesh.h"
+#include "JobSystem.h"
 #include "events/EventThread.h"
 #include "utils/Chunkindex.h"
 #include "utils/Property.h"
@@ -20,35 +38,374 @@ namespace Engine {
 	class Shader;
 };
 
+struct ChunkStats
+{
+	std::size_t chunks = 0;
+	std::size_t uniformChunks = 0; // Chunks holding a single block type and no block array
+	std::size_t allocatedSections = 0;
+	std::size_t blockMemory = 0; // Bytes held by the block storage of all loaded chunks
+	double averageMeshingMs = 0.0; // Mean time to mesh a generated chunk with the current meshing mode
+	double averageGenerationMs = 0.0; // Mean time to fill a chunk with terrain
+	std::size_t vertices = 0; // Vertices of all uploaded chunk meshes
+	std::size_t lastFrameDrawnVertices = 0; // Vertices of the faces pointing to the camera
+	std::size_t uploadedBytes = 0; // Vertex bytes uploaded to the GPU since start
+	std::size_t pendingUploads = 0; // Meshed chunks waiting for their GPU upload
+	std::size_t lastFrameUploadedBytes = 0;
+	std::size_t meshMemory = 0; // CPU vertex bytes not yet uploaded, plus the meshing buffers
+	std::size_t peakMeshMemory = 0;
+	// Edits uploaded by patching the changed sections, and by meshing the whole chunk
+	std::size_t patchedEdits = 0;
+	std::size_t remeshedEdits = 0;
+	// Mean time from World::set until the edit is uploaded to the GPU
+	double patchLatencyMs = 0.0;
+	double remeshLatencyMs = 0.0;
+	std::array<std::size_t, MAX_MESH_LOD + 1> lodChunks {}; // Chunks with an uploaded mesh by its level of detail
+	// Generated chunks proven all air before sampling any density, by the highest surface the height
+	// function can produce and by the chunk's heightmap, and the chunks that had to be sampled
+	std::size_t airAboveMaxHeight = 0;
+	std::size_t airAboveSurface = 0;
+	std::size_t sampledChunks = 0;
+	double averageSampledLayers = 0.0; // Block layers from the bottom up to the highest surface
+	double averageDensityEvaluations = 0.0; // 3D noise evaluations per generated chunk
+	// Blocks of the last comparison of the density sampling with exact evaluation, and how many differed
+	std::size_t comparedBlocks = 0;
+	double densityDifferenceRate = 0.0;
+	std::uint64_t renderListEpoch = 0; // Render lists published so far, see RenderList
+	std::size_t retiredChunks = 0; // Unloaded chunks the render thread has not destroyed yet
+	std::size_t chunksMutexContentions = 0; // Times a thread had to wait for the loaded chunks
+	std::size_t renderListMismatches = 0; // Chunks listed at the wrong index, only counted by stressRenderList()
+};
+
+// Block access through the palette storage against a flat array of block types, on the chunks of
+// a loaded world. See ChunkManager::benchmarkBlockStorage().
+struct BlockStorageBenchmark
+{
+	std::size_t chunks = 0;
+	std::size_t paletteBytes = 0; // Block memory of the loaded chunks
+	std::size_t flatBytes = 0; // One flat array of block types per chunk
+	double paletteGetsPerSecond = 0.0;
+	double flatGetsPerSecond = 0.0;
+	double paletteSetsPerSecond = 0.0;
+	double flatSetsPerSecond = 0.0;
+	std::size_t mismatches = 0; // Blocks read back differently from the two
+};
+
+// The naive and the binary mesher on the chunks of a loaded world, see ChunkManager::compareMeshers()
+struct MesherComparison
+{
+	std::size_t chunks = 0;
+	std::size_t faces = 0; // Of the naive meshes
+	std::size_t mismatchedChunks = 0; // Chunks whose sets of faces differ between the two
+	double naiveMs = 0.0; // Mean time to mesh a chunk
+	double binaryMs = 0.0;
+};
+
+// The vertices of the chunk meshes of a loaded world as independent triangles and as indexed quads,
+// per chunk and meshed at full detail. See ChunkManager::benchmarkMesh().
+struct MeshBenchmark
+{
+	MeshingMode mode = MeshingMode::Binary;
+	std::size_t chunks = 0;
+	double faces = 0.0;
+	double triangleVertices = 0.0; // 6 per face, drawn without indices
+	double quadVertices = 0.0; // 4 per face, drawn through the shared quad index buffer
+	double uploadedVertices = 0.0; // The quad vertices plus the spare capacity for patches
+	std::size_t indexBufferBytes = 0; // The shared quad indices of the largest mesh, once for all chunks
+};
+
+// When the block edit that caused a meshing job was made, if any
+using EditTime = std::optional<std::chrono::steady_clock::time_point>;
+
+// The chunks of a column generated by one job, from the top down
+using GeneratedChunks = std::vector<std::pair<ChunkIndex, std::unique_ptr<Engine::Chunk>>>;
+
+// How much mesh data the render thread uploads per frame. At least one mesh is uploaded every
+// frame, even if it alone exceeds the budget.
+struct UploadBudget
+{
+	std::size_t bytesPerFrame = 8 * 1024 * 1024;
+	float millisecondsPerFrame = 2.0f;
+};
+
+// Distances from the player's chunk, in chunks along any axis, from which chunks are meshed with
+// cells of 2x2x2 and 4x4x4 blocks
+struct LodRings
+{
+	int halfDetail = 2;
+	int quarterDetail = 4;
+};
+
+// How the terrain density is sampled. With a spacing above 1 the density is only evaluated on a
+// lattice with points every spacing blocks and interpolated trilinearly between them. Blocks whose
+// interpolated density lies within refineMargin of the solid threshold are evaluated exactly.
+struct DensitySampling
+{
+	int spacing = 4; // 1 evaluates every block, otherwise a divisor of the chunk size
+	float refineMargin = 0.025f;
+
+	bool operator==(const DensitySampling&) const = default;
+};
+
+// What bounds on the terrain functions prove about a chunk before its density is sampled
+struct TerrainClass
+{
+	enum Kind { AboveMaxHeight, AboveSurface, Sampled };
+
+	Kind kind = Sampled;
+	int top = -1; // Highest block y of the chunk that can be solid, for sampled chunks
+};
+
+// The topmost grass block of every block column of a chunk column, carried down from chunk to
+// chunk while generating. It only depends on the terrain, so a chunk gets the same blocks no
+// matter which chunks above it are loaded or in which order columns are generated.
+struct ColumnSurface
+{
+	static constexpr int NONE = std::numeric_limits<int>::max();
+
+	int chunkY = 0; // Covers every block from the bottom of the chunk at this index y upwards,
+	                // down to the grass and dirt. Chunks below them never need a surface.
+	DensitySampling sampling;
+	std::vector<int> grassY; // World y of the grass block, or NONE, indexed by x + BLOCKS_X * z
+};
+
+// The loaded chunks, as published by the chunk manager thread whenever it loads or unloads any.
+// Which chunks a published list holds never changes, so the render thread reads it without
+// locking. The blocks and meshes of those chunks still change, under their own synchronization.
+// Every list owns the one published before it and the chunks unloaded since then. The render
+// thread frees the lists older than the one it uses, and with them the chunks it can no longer draw.
+struct RenderList
+{
+	RenderList() = default;
+	~RenderList();
+
+	std::uint64_t epoch = 0; // Increases with every published list
+	std::vector<std::pair<glm::ivec3, Engine::Chunk*>> chunks; // Sorted by index
+
+	std::unique_ptr<RenderList> previous;
+	std::vector<std::unique_ptr<Engine::Chunk>> unloaded; // Chunks of the previous list missing in this one
+
+	// The chunk at the index, or nullptr if it is not in the list
+	[[nodiscard]] Engine::Chunk* at(const glm::ivec3& index) const;
+};
+
+// A mesh built by a meshing job, waiting for the render thread to upload it
+struct CompletedMesh
+{
+	glm::ivec3 chunkIndex;
+	std::uint64_t sequence; // Increases with every started meshing job
+	std::unique_ptr<ChunkMesh> mesh; // A complete mesh or a patch, see ChunkMesh::patchedSections()
+	EditTime editTime;
+};
+
 class ChunkManager
 {
 public:
-	explicit ChunkManager(GLuint texture);
+	// Generation and meshing run as jobs on the given pool
+	explicit ChunkManager(GLuint texture, JobSystem& jobs = JobSystem::instance());
 	~ChunkManager();
 
+	// Loads the world around a fixed origin without rendering it, with generation and meshing on a
+	// pool of the given number of workers. Returns the chunks generated and meshed per second.
+	[[nodiscard]] static double benchmarkWorldLoad(std::size_t workers);
+
+	// Copies the blocks of every chunk of the loaded world into a BlockStorage and a flat array in
+	// scattered order, then reads them back
+	[[nodiscard]] static BlockStorageBenchmark benchmarkBlockStorage();
+
+	// Meshes every chunk of the loaded world at full detail with the naive and the binary mesher
+	// and compares the faces, which only differ in their order
+	[[nodiscard]] static MesherComparison compareMeshers();
+
+	// Meshes every chunk of the loaded world at full detail in every meshing mode and counts the vertices
+	[[nodiscard]] static std::vector<MeshBenchmark> benchmarkMesh();
+
 	Property<glm::ivec3> sourceChunk;
 
-	bool isWithinViewDistance(Engine::Chunk* chunk, const glm::vec3& playerPos) const;
 	bool isWithinViewDistance(const ChunkIndex& chunk, const ChunkIndex& playerChunk) const;
 	bool isWithinViewDistance(const glm::ivec3& offset) const;
+	bool isColumnWithinViewDistance(const glm::ivec2& column, const glm::ivec2& originColumn) const;
 
-	void ensureChunkAtIndex(const ChunkIndex& index);
-	void addChunkAt(const ChunkIndex& index, GLuint texture);
 	Engine::Chunk* chunkAt(const ChunkIndex& index) const;
 
+	// Uploads pending meshes and draws the chunks of the latest render list. Must be called on the
+	// render thread, like setUploadBudget() and stats().
 	void renderChunks(const glm::vec3& playerPos, const Engine::Shader& shader, const glm::mat4& viewProjectionMatrix);
 
+	// Loads the world while moving the origin and editing blocks, and reads the render lists on
+	// the calling thread meanwhile, like the render thread without drawing. Returns the stats at
+	// the end, to check that reading the lists never waited for the loaded chunks.
+	[[nodiscard]] static ChunkStats stressRenderList(std::chrono::milliseconds duration);
+
+	// Changes a block on the chunk manager thread. Edits in chunks that are not loaded are dropped.
+	void setBlock(const glm::ivec3& worldPos, Engine::BlockType type);
+
+	// Whether edits patch the changed sections of a mesh instead of meshing the whole chunk
+	void setIncrementalEdits(bool enabled);
+
+	void setUploadBudget(const UploadBudget& budget);
+	void setLodRings(const LodRings& rings);
+	// Rounds the spacing down to a divisor of the chunk size
+	void setDensitySampling(const DensitySampling& sampling);
+
+	// Generates the chunks around the player both with exact density and with the current sampling
+	// and counts the blocks that differ, see ChunkStats::densityDifferenceRate. Runs on the chunk
+	// manager thread.
+	void compareDensitySampling();
+
+	[[nodiscard]] ChunkStats stats() const;
+
 private:
+	// Loads the world around the benchmark origin and waits until every chunk in view is generated
+	// and meshed. Returns the number of chunks.
+	static std::size_t loadBenchmarkWorld(ChunkManager& manager);
+
+	// Loads the world on the default pool and calls function for every loaded chunk afterwards
+	static void forEachBenchmarkChunk(const std::function<void(Engine::Chunk&)>& function);
+
+	// Meshes the chunk and queues the result for upload. Runs as a job: the chunk is copied with
+	// m_blocksMutex shared, which keeps the chunk manager thread from changing it meanwhile.
+	void meshChunk(const ChunkIndex& index, EditTime editTime);
+
+	// Generates the chunks, top-down in one column, and hands them to the chunk manager thread.
+	// Runs as a job.
+	void generateColumn(const std::vector<ChunkIndex>& indices, DensitySampling sampling);
+
+	// Generates a chunk that is not yet linked to its neighbors and moves the surface below it.
+	// If the chunk reaches into the grass and dirt, the surface is first moved down through the
+	// chunks between it and this one. Thread safe.
+	std::unique_ptr<Engine::Chunk> generateChunk(const ChunkIndex& index, ColumnSurface& surface, const DensitySampling& sampling);
+
+	// Moves the surface below the chunk without building it or counting it as generated. Thread safe.
+	void generateSurface(const ChunkIndex& index, ColumnSurface& surface, const DensitySampling& sampling);
+
+	// The surface of the column right above the terrain, where no block is solid. Thread safe.
+	ColumnSurface columnTop(const glm::ivec2& column, const DensitySampling& sampling);
+
+	// The cached surface of the column if it covers everything above the chunk, otherwise the
+	// surface above the terrain. Thread safe.
+	ColumnSurface columnSurfaceAbove(const ChunkIndex& index, const DensitySampling& sampling);
+
+	// Caches the surface unless a lower one of the same sampling is cached already. Thread safe.
+	void storeColumnSurface(const glm::ivec2& column, ColumnSurface surface);
+
+	// Starts a generation job for the chunks of the column that are neither loaded nor being
+	// generated. Runs on the chunk manager thread, like all functions below up to uploadPendingMeshes().
+	void requestColumn(const glm::ivec3& column);
+
+	// Links the generated chunks to their neighbors, makes them visible with a single render list
+	// and schedules their meshing
+	void insertChunks(GeneratedChunks chunks);
+
+	// Meshes only the sections set in the bit mask and queues the result as a patch
+	void meshSections(const ChunkIndex& index, std::uint64_t sections, EditTime editTime);
+
+	// Schedules a meshing job unless one is already pending for the chunk
+	void requestRemesh(const ChunkIndex& index, EditTime editTime = std::nullopt);
+
+	// Sets the block and updates the meshes of the chunks sharing a face with it
+	void applyBlockEdit(const glm::ivec3& worldPos, Engine::BlockType type, EditTime editTime);
+
+	// Terrain height of every block column of a chunk column, indexed by x + BLOCKS_X * z.
+	// Computed once for all chunks stacked at the column's x and z. Thread safe.
+	std::shared_ptr<const std::vector<int>> heightmapAt(const glm::ivec2& column);
+
+	// What bounds on the height function prove about the chunk, before sampling any density
+	TerrainClass classifyTerrain(const ChunkIndex& index);
+
+	// Fills the all-air chunk with the terrain up to top and returns the number of 3D noise
+	// evaluations. grassY is the surface above the chunk and is moved below it. Without a chunk,
+	// only the surface is moved.
+	std::size_t generateTerrain(Engine::Chunk* chunk, const ChunkIndex& index, int top, const DensitySampling& sampling,
+	                            std::span<int> grassY);
+
+	// Generates the chunks around the player both ways and records how many blocks differ
+	void runDensityComparison();
+
+	[[nodiscard]] std::uint8_t lodAt(const ChunkIndex& index) const;
+
+	// Remeshes the chunks whose level of detail changed with the player's chunk or the rings,
+	// along with their neighbors, whose seams change
+	void updateLods();
+
+	// Uploads the pending meshes closest to the player first until the budget is used up.
+	// Must be called on the render thread.
+	void uploadPendingMeshes(const glm::vec3& playerPos, const RenderList& renderList);
+
+	// Locks m_chunksMutex, counting the times it is held by another thread
+	[[nodiscard]] std::unique_lock<std::mutex> lockChunks() const;
+
+	// Publishes a render list of the loaded chunks. The unloaded chunks are destroyed by the
+	// render thread once it uses a later list. Runs on the chunk manager thread.
+	void publishRenderList(std::vector<std::unique_ptr<Engine::Chunk>> unloaded = {});
+
+	// The latest render list. Frees the lists before it. Must be called on the render thread.
+	const RenderList& acquireRenderList();
+
 	Observer m_observer;
 
+	JobSystem& m_jobs;
 	std::unique_ptr<ChunkManagerThread> m_thread;
 	std::optional<ChunkIndex> m_playerChunk = {};
+	// Guards m_chunks against the chunk manager thread loading and unloading chunks. Never locked
+	// by the render thread, which uses m_renderList instead.
 	mutable std::mutex m_chunksMutex;
+	mutable std::atomic<std::size_t> m_chunksMutexContentions = 0;
+	// Held exclusively by the chunk manager thread while it changes the blocks, neighbors or level
+	// of detail of loaded chunks or unloads them, and shared by the jobs reading loaded chunks
+	mutable std::shared_mutex m_blocksMutex;
 
-	std::unordered_map<std::size_t, std::unique_ptr<Engine::Chunk>> m_chunks;
+	ChunkGrid m_chunks;
+	std::unique_ptr<RenderList> m_latestRenderList; // Only accessed by the chunk manager thread
+	std::atomic<RenderList*> m_renderList; // The latest list, for the render thread
+	std::atomic<std::size_t> m_retiredChunks = 0; // Unloaded chunks not destroyed yet
 	siv::BasicPerlinNoise<float> m_perlinNoise;
+	BatchNoise m_batchNoise { m_perlinNoise };
 
 	GLuint m_texture;
 
+	std::mutex m_completedMeshesMutex;
+	std::vector<CompletedMesh> m_completedMeshes;
+	std::atomic<std::uint64_t> m_meshSequence = 0;
+	std::mutex m_remeshQueueMutex;
+	std::unordered_set<glm::ivec3> m_remeshQueue; // Chunks with a meshing job that has not copied them yet
+	std::mutex m_heightmapsMutex;
+	std::unordered_map<glm::ivec2, std::shared_ptr<const std::vector<int>>> m_heightmaps; // Dropped with their chunks
+	std::optional<glm::ivec2> m_heightmapsOrigin; // Column of the origin the heightmaps were last dropped for
+	std::mutex m_columnSurfacesMutex;
+	std::unordered_map<glm::ivec2, ColumnSurface> m_columnSurfaces; // Lowest generated surface, dropped with the heightmaps
+	std::optional<glm::ivec2> m_columnSurfacesOrigin; // Column of the origin the surfaces were last dropped for
+
+	// Only accessed by the chunk manager thread
+	std::unordered_set<glm::ivec3> m_pendingChunks; // Chunks with a generation job
+	LodRings m_lodRings;
+	DensitySampling m_densitySampling;
+
+	// Only accessed on the render thread
+	std::vector<CompletedMesh> m_pendingUploads;
+	UploadBudget m_uploadBudget;
+	std::size_t m_lastFrameUploadedBytes = 0;
+	std::size_t m_lastFrameDrawnVertices = 0;
+	std::size_t m_patchedEdits = 0;
+	std::size_t m_remeshedEdits = 0;
+	double m_patchLatencyMs = 0.0; // Summed over all patched edits
+	double m_remeshLatencyMs = 0.0;
+
+	std::atomic<bool> m_incrementalEdits = true;
+
+	std::atomic<MeshingMode> m_statsMeshingMode = ChunkMesh::mode();
+	std::atomic<std::size_t> m_meshedChunks = 0;
+	std::atomic<std::size_t> m_meshingMicroseconds = 0;
+	std::atomic<std::size_t> m_generatedChunks = 0;
+	std::atomic<std::size_t> m_insertedChunks = 0;
+	std::atomic<std::size_t> m_generationMicroseconds = 0;
+	std::atomic<std::size_t> m_densityEvaluations = 0;
+	std::atomic<std::size_t> m_airAboveMaxHeight = 0;
+	std::atomic<std::size_t> m_airAboveSurface = 0;
+	std::atomic<std::size_t> m_sampledChunks = 0;
+	std::atomic<std::size_t> m_sampledLayers = 0;
+	std::atomic<std::size_t> m_comparedBlocks = 0;
+	std::atomic<std::size_t> m_differentBlocks = 0;
+	std::size_t m_uploadedBytes = 0; // Only accessed on the render thread
+
 	friend class ChunkManagerThread;
 };
\ No newline at end of file
@@ -1,76 +1,370 @@
 #include "ChunkMesh.h"
 #include "Chunk.h"
 
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <optional>
+#include <type_traits>
+
 using namespace Engine;
 
 namespace
 {
 
-// How many block types there are
-constexpr auto numTypes = 4;
-// How many vertices per block side
-constexpr auto numVertices = 6;
-
-constexpr auto texArraySize = numTypes * numVertices;
-constexpr std::array<glm::vec2, texArraySize> texLookup {
-
-        /* 0. GRASS SIDE */
-        glm::vec2{ 0.635f, 0.9375f },
-        glm::vec2{ 0.759f, 0.9375f },
-        glm::vec2{ 0.635f, 1.0f },
-        glm::vec2{ 0.635f, 1.0f },
-        glm::vec2{ 0.759f, 0.9375f },
-        glm::vec2{ 0.759f, 1.0f },
-
-        /* 1. GRASS TOP */
-
-        glm::vec2{ 0.507f, 0.557f },
-        glm::vec2{ 0.633f, 0.557f },
-        glm::vec2{ 0.507f, 0.619f },
-        glm::vec2{ 0.507f, 0.619f },
-        glm::vec2{ 0.633f, 0.557f },
-        glm::vec2{ 0.633f, 0.619f },
-
-        /* 2. DIRT */
-
-        glm::vec2{ 0.634f, 0.875f },
-        glm::vec2{ 0.759f, 0.875f },
-        glm::vec2{ 0.634f, 0.936f },
-        glm::vec2{ 0.634f, 0.936f },
-        glm::vec2{ 0.759f, 0.875f },
-        glm::vec2{ 0.759f, 0.936f },
-
-        /* 3. STONE */
-
-        glm::vec2{ 0.254f, 0.62f },
-        glm::vec2{ 0.379f, 0.62f },
-        glm::vec2{ 0.254f, 0.683f },
-        glm::vec2{ 0.254f, 0.683f },
-        glm::vec2{ 0.379f, 0.62f },
-        glm::vec2{ 0.379f, 0.683f },
+// How many block textures there are in the atlas
+constexpr auto numTiles = 4;
+// How many vertices per block side, the triangles are built by Chunk's shared quad index buffer
+constexpr auto numVertices = 4;
+
+// Atlas rectangle (min u, min v, max u, max v) of every block texture, indexed by Vertex::tile()
+constexpr std::array<glm::vec4, numTiles> atlasTileRects {
+        /* 0. GRASS SIDE */ glm::vec4{ 0.635f, 0.9375f, 0.759f, 1.0f },
+        /* 1. GRASS TOP */  glm::vec4{ 0.507f, 0.557f, 0.633f, 0.619f },
+        /* 2. DIRT */       glm::vec4{ 0.634f, 0.875f, 0.759f, 0.936f },
+        /* 3. STONE */      glm::vec4{ 0.254f, 0.62f, 0.379f, 0.683f },
 };
 
-std::size_t atlasLookup(BlockType type, BlockSide side)
+std::uint8_t tileLookup(BlockType type, BlockSide side)
 {
     switch (type) {
         case BlockType::GRASS:
             switch(side) {
-                case BlockSide::SIDE: return 0 * 6;
-                case BlockSide::TOP: return 1 * 6;
-                case BlockSide::BOTTOM: return 2 * 6;
+                case BlockSide::SIDE: return 0;
+                case BlockSide::TOP: return 1;
+                case BlockSide::BOTTOM: return 2;
             }
-        case BlockType::DIRT: return 2*6;
-        case BlockType::STONE: return 3*6;
+            break;
+        case BlockType::DIRT: return 2;
+        case BlockType::STONE: return 3;
+        default: break;
     }
     return 0;
 }
 
+BlockSide sideOf(Direction dir)
+{
+    switch (dir) {
+        case Direction::NegY: return BlockSide::BOTTOM;
+        case Direction::PlusY: return BlockSide::TOP;
+        default: return BlockSide::SIDE;
+    }
+}
+
+// Corners of a block face relative to the block, indexed by Direction. The face is drawn as the
+// triangles (0, 1, 2) and (2, 1, 3).
+constexpr std::array<std::array<glm::ivec3, numVertices>, 6> faceCorners {{
+    /* - X */ {{ {0, 0, 0}, {0, 0, 1}, {0, 1, 0}, {0, 1, 1} }},
+    /* + X */ {{ {1, 0, 1}, {1, 0, 0}, {1, 1, 1}, {1, 1, 0} }},
+    /* - Y */ {{ {0, 0, 1}, {0, 0, 0}, {1, 0, 1}, {1, 0, 0} }},
+    /* + Y */ {{ {0, 1, 0}, {0, 1, 1}, {1, 1, 0}, {1, 1, 1} }},
+    /* - Z */ {{ {1, 0, 0}, {0, 0, 0}, {1, 1, 0}, {0, 1, 0} }},
+    /* + Z */ {{ {0, 0, 1}, {1, 0, 1}, {0, 1, 1}, {1, 1, 1} }},
+}};
+
+struct PlaneAxes
+{
+    int normal;
+    int u; // Axis along which the texture u coordinate grows
+    int v; // Axis along which the texture v coordinate grows
+};
+
+// Indexed by Direction / 2. Matches the corner order of faceCorners and the texture
+// coordinates built in shader.vert.
+constexpr std::array<PlaneAxes, 3> planeAxes {{
+    { 0, 2, 1 },
+    { 1, 2, 0 },
+    { 2, 0, 1 },
+}};
+
+// Emits a face covering size blocks starting at pos. The size along the face normal is always 1.
+void emitQuad(std::vector<Vertex>& vertices, Direction dir, const glm::ivec3& pos, const glm::ivec3& size, std::uint8_t tile)
+{
+    const auto& corners = faceCorners.at(std::size_t(dir));
+    for (std::size_t i = 0; i < numVertices; i++) {
+        const auto corner = pos + corners.at(i) * size;
+        vertices.push_back(Vertex::pack(std::uint32_t(corner.x), std::uint32_t(corner.y), std::uint32_t(corner.z),
+                                        std::uint32_t(dir), std::uint32_t(i), tile));
+    }
+}
+
+void emitFace(std::vector<Vertex>& vertices, Direction dir, const glm::ivec3& pos, BlockType type)
+{
+    emitQuad(vertices, dir, pos, glm::ivec3{1, 1, 1}, tileLookup(type, sideOf(dir)));
+}
+
+// The cells of a coarse mesh plus a one cell border, laid out like ChunkMesh::Snapshot. Bit x + 1
+// of a row is the solid state of cell x, so the border cells at x = -1 and x = cells share the word.
+struct CoarseGrid
+{
+    static constexpr int MAX_CELLS = ChunkData::BLOCKS_X / 2;
+    static constexpr int EXTENT = MAX_CELLS + 2;
+
+    static constexpr std::size_t rowIndex(int y, int z)
+    {
+        return std::size_t((y + 1) + EXTENT * (z + 1));
+    }
+
+    std::array<std::uint64_t, std::size_t(EXTENT * EXTENT)> solidRows;
+    // Block type of the inner cells, indexed by x + cells * (y + cells * z). 0 until first needed.
+    std::array<std::uint8_t, std::size_t(MAX_CELLS * MAX_CELLS * MAX_CELLS)> types;
+};
+
+constexpr auto numBlockTypes = std::size_t(BlockType::STONE) + 1;
+
+// Solid blocks among the scale^3 blocks starting at (x, y, z), counted in the rows of a solid mask
+template <typename SolidRow>
+int solidBlocks(const SolidRow& solidRow, int x, int y, int z, int scale)
+{
+    const auto bits = ((std::uint64_t{1} << scale) - 1) << x;
+    auto count = 0;
+    for (auto dz = 0; dz < scale; dz++) {
+        for (auto dy = 0; dy < scale; dy++) {
+            count += std::popcount(solidRow(y + dy, z + dz) & bits);
+        }
+    }
+    return count;
+}
+
+// A cell is solid if at least half of its blocks are, so the coarse surface stays close to the real one
+bool isSolidCell(int solidBlocks, int scale)
+{
+    return 2 * solidBlocks >= scale * scale * scale;
+}
+
+// Border cell of a coarse mesh, the cells of the neighbor in direction dir that touch the chunk, downsampled
+// from the neighbor's solid mask. (a, b) are the cell's coordinates along the two other axes.
+bool isSolidBorderCell(const Chunk& neighbor, std::size_t dir, int a, int b, int scale)
+{
+    const auto axis = int(dir / 2);
+    auto origin = glm::ivec3{};
+    origin[axis] = dir % 2 == 1 ? 0 : ChunkData::BLOCKS_X - scale;
+    origin[(axis + 1) % 3] = a * scale;
+    origin[(axis + 2) % 3] = b * scale;
+    const auto neighborRow = [&neighbor](int y, int z) { return neighbor.solidRow(y, z); };
+    return isSolidCell(solidBlocks(neighborRow, origin.x, origin.y, origin.z, scale), scale);
+}
+
+// Whether a section and its six neighbor sections in the same chunk are all solid
+bool isEnclosedSection(const Chunk& chunk, int x, int y, int z)
+{
+    const auto isInner =
+        x > 0 && x < ChunkData::SECTIONS_X - 1 &&
+        y > 0 && y < ChunkData::SECTIONS_Y - 1 &&
+        z > 0 && z < ChunkData::SECTIONS_Z - 1;
+    if (!isInner) {
+        return false;
+    }
+
+    const auto isFull = [&chunk](int sx, int sy, int sz) {
+        const auto section = chunk.section(sx, sy, sz);
+        return section && section->isFull();
+    };
+    return isFull(x, y, z) &&
+        isFull(x - 1, y, z) && isFull(x + 1, y, z) &&
+        isFull(x, y - 1, z) && isFull(x, y + 1, z) &&
+        isFull(x, y, z - 1) && isFull(x, y, z + 1);
+}
+
+}
+
+// A private copy of everything meshing reads: the chunk's blocks plus the layer of blocks touching
+// it in each of its six neighbors. With the border in place, face culling reads the neighbor of
+// every block the same way, without checking for the chunk edge or a missing neighbor chunk.
+struct ChunkMesh::Snapshot
+{
+    static constexpr int EXTENT = ChunkData::BLOCKS_X + 2;
+
+    // Coordinates are in [-1, BLOCKS_X/Y/Z]
+    static constexpr std::size_t blockIndex(int x, int y, int z)
+    {
+        return std::size_t((x + 1) + EXTENT * ((y + 1) + EXTENT * (z + 1)));
+    }
+
+    static constexpr std::size_t rowIndex(int y, int z)
+    {
+        return std::size_t((y + 1) + EXTENT * (z + 1));
+    }
+
+    [[nodiscard]] BlockType get(int x, int y, int z) const { return BlockType(blocks[blockIndex(x, y, z)]); }
+    [[nodiscard]] bool isSolid(int x, int y, int z) const { return blocks[blockIndex(x, y, z)] != air; }
+    [[nodiscard]] std::uint64_t solidRow(int y, int z) const { return solidRows[rowIndex(y, z)]; }
+
+    // Neighbors across a seam are left out, so the faces towards them are kept
+    void copy(const Chunk& chunk, const MeshDetail& detail);
+
+    static constexpr auto air = std::uint8_t(BlockType::AIR);
+
+    // Block types of the 66^3 padded volume. Missing neighbors and the edges of the padding,
+    // which no face borders, are air.
+    std::array<std::uint8_t, std::size_t(EXTENT * EXTENT * EXTENT)> blocks;
+    // Solid mask rows for y and z in [-1, 64], bit x for x in [0, 64)
+    std::array<std::uint64_t, std::size_t(EXTENT * EXTENT)> solidRows;
+    // Solid bit of the padding blocks at x = -1 and x = 64 of every row, in bit 0
+    std::array<std::uint64_t, std::size_t(EXTENT * EXTENT)> negXEdge;
+    std::array<std::uint64_t, std::size_t(EXTENT * EXTENT)> posXEdge;
+
+    std::optional<BlockType> uniformType;
+    // Sections with blocks that are not enclosed by full sections, one bit per section index
+    std::uint64_t visibleSections = 0;
+    // For coarse meshes, the solid border cells of the neighbor in every direction. Bit a of
+    // entry dir * MAX_CELLS + b is cell (a, b), see isSolidBorderCell().
+    std::array<std::uint32_t, 6 * CoarseGrid::MAX_CELLS> coarseBorder;
+};
+
+static_assert(std::tuple_size_v<MeshLayout> == 6 * ChunkData::SECTIONS, "One mesh slot per direction and section");
+static_assert(std::is_same_v<std::underlying_type_t<BlockType>, int> && int(BlockType::STONE) < 256,
+    "Snapshot stores block types in a byte");
+static_assert(CoarseGrid::EXTENT <= 64, "A row of coarse cells and its border cells fit into one word");
+static_assert(ChunkData::BLOCKS_X % (1 << MAX_MESH_LOD) == 0, "Coarse cells tile the chunk");
+
+void ChunkMesh::Snapshot::copy(const Chunk& chunk, const MeshDetail& detail)
+{
+    const auto seams = detail.seams;
+    constexpr auto maxX = ChunkData::BLOCKS_X - 1;
+    constexpr auto maxY = ChunkData::BLOCKS_Y - 1;
+    constexpr auto maxZ = ChunkData::BLOCKS_Z - 1;
+    constexpr auto extent = ChunkData::SECTION_EXTENT;
+
+    blocks.fill(air);
+    solidRows.fill(0);
+    negXEdge.fill(0);
+    posXEdge.fill(0);
+    coarseBorder.fill(0);
+    uniformType = chunk.uniformType();
+    visibleSections = 0;
+    if (uniformType == BlockType::AIR) {
+        return;
+    }
+
+    // Decode whole sections at once and copy them row by row
+    std::array<BlockType, ChunkData::SECTION_BLOCKS> sectionBlocks;
+    for (auto sz = 0; sz < ChunkData::SECTIONS_Z; sz++) {
+        for (auto sy = 0; sy < ChunkData::SECTIONS_Y; sy++) {
+            for (auto sx = 0; sx < ChunkData::SECTIONS_X; sx++) {
+                const auto section = chunk.section(sx, sy, sz);
+                if (!section) {
+                    continue;
+                }
+                if (!isEnclosedSection(chunk, sx, sy, sz)) {
+                    visibleSections |= std::uint64_t{1} << (sx + ChunkData::SECTIONS_X * (sy + ChunkData::SECTIONS_Y * sz));
+                }
+                section->copyBlocks(sectionBlocks);
+                for (auto z = 0; z < extent; z++) {
+                    for (auto y = 0; y < extent; y++) {
+                        const auto* const source = &sectionBlocks[std::size_t(extent * (y + extent * z))];
+                        auto* const target = &blocks[blockIndex(sx * extent, sy * extent + y, sz * extent + z)];
+                        for (auto x = 0; x < extent; x++) {
+                            target[x] = std::uint8_t(source[x]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    for (auto z = 0; z < ChunkData::BLOCKS_Z; z++) {
+        for (auto y = 0; y < ChunkData::BLOCKS_Y; y++) {
+            solidRows[rowIndex(y, z)] = chunk.solidRow(y, z);
+        }
+    }
+
+    // The border layers. Only their solid state matters for culling, so copy the solid masks and
+    // store the neighbor's block types for the solid blocks only.
+    const auto copyBorder = [this](const Chunk* neighbor, int x, int y, int z, int neighborX, int neighborY, int neighborZ) {
+        if (neighbor->isSolid(neighborX, neighborY, neighborZ)) {
+            blocks[blockIndex(x, y, z)] = std::uint8_t(neighbor->get(neighborX, neighborY, neighborZ));
+        }
+    };
+    const auto neighbor = [&chunk, seams](Direction dir) {
+        return ((seams >> int(dir)) & 1) != 0 ? nullptr : chunk.neighbor(dir);
+    };
+    if (const auto negX = neighbor(Direction::NegX)) {
+        for (auto z = 0; z < ChunkData::BLOCKS_Z; z++) {
+            for (auto y = 0; y < ChunkData::BLOCKS_Y; y++) {
+                negXEdge[rowIndex(y, z)] = negX->solidRow(y, z) >> maxX;
+                copyBorder(negX, -1, y, z, maxX, y, z);
+            }
+        }
+    }
+    if (const auto posX = neighbor(Direction::PlusX)) {
+        for (auto z = 0; z < ChunkData::BLOCKS_Z; z++) {
+            for (auto y = 0; y < ChunkData::BLOCKS_Y; y++) {
+                posXEdge[rowIndex(y, z)] = posX->solidRow(y, z) & 1;
+                copyBorder(posX, maxX + 1, y, z, 0, y, z);
+            }
+        }
+    }
+    if (const auto negY = neighbor(Direction::NegY)) {
+        for (auto z = 0; z < ChunkData::BLOCKS_Z; z++) {
+            solidRows[rowIndex(-1, z)] = negY->solidRow(maxY, z);
+            for (auto x = 0; x < ChunkData::BLOCKS_X; x++) {
+                copyBorder(negY, x, -1, z, x, maxY, z);
+            }
+        }
+    }
+    if (const auto posY = neighbor(Direction::PlusY)) {
+        for (auto z = 0; z < ChunkData::BLOCKS_Z; z++) {
+            solidRows[rowIndex(maxY + 1, z)] = posY->solidRow(0, z);
+            for (auto x = 0; x < ChunkData::BLOCKS_X; x++) {
+                copyBorder(posY, x, maxY + 1, z, x, 0, z);
+            }
+        }
+    }
+    if (const auto negZ = neighbor(Direction::NegZ)) {
+        for (auto y = 0; y < ChunkData::BLOCKS_Y; y++) {
+            solidRows[rowIndex(y, -1)] = negZ->solidRow(y, maxZ);
+            for (auto x = 0; x < ChunkData::BLOCKS_X; x++) {
+                copyBorder(negZ, x, y, -1, x, y, maxZ);
+            }
+        }
+    }
+    if (const auto posZ = neighbor(Direction::PlusZ)) {
+        for (auto y = 0; y < ChunkData::BLOCKS_Y; y++) {
+            solidRows[rowIndex(y, maxZ + 1)] = posZ->solidRow(y, 0);
+            for (auto x = 0; x < ChunkData::BLOCKS_X; x++) {
+                copyBorder(posZ, x, y, maxZ + 1, x, y, 0);
+            }
+        }
+    }
+
+    if (detail.lod > 0) {
+        const auto scale = 1 << detail.lod;
+        const auto cells = ChunkData::BLOCKS_X / scale;
+        for (std::size_t dir = 0; dir < 6; dir++) {
+            const auto other = neighbor(Direction(dir));
+            if (!other) {
+                continue;
+            }
+            for (auto b = 0; b < cells; b++) {
+                auto& row = coarseBorder[dir * CoarseGrid::MAX_CELLS + std::size_t(b)];
+                for (auto a = 0; a < cells; a++) {
+                    row |= isSolidBorderCell(*other, dir, a, b, scale) ? std::uint32_t{1} << a : 0;
+                }
+            }
+        }
+    }
 }
 
-ChunkMesh::ChunkMesh(Chunk* chunk)
+std::atomic<MeshingMode> ChunkMesh::s_mode = MeshingMode::Binary;
+
+std::atomic<std::size_t> ChunkMesh::s_memory = 0;
+std::atomic<std::size_t> ChunkMesh::s_peakMemory = 0;
+
+ChunkMesh::ChunkMesh(Chunk* chunk, MeshDetail detail)
     : m_chunk(chunk)
+    , m_detail(detail)
+{
+}
+
+ChunkMesh::~ChunkMesh()
+{
+    releaseVertices();
+}
+
+std::vector<glm::vec4> ChunkMesh::atlasTiles()
 {
-    m_vertices.reserve(ChunkData::BLOCKS * 6 * 6);
+    return { atlasTileRects.begin(), atlasTileRects.end() };
 }
 
 const std::vector<Vertex>& ChunkMesh::vertices() const
@@ -78,96 +372,535 @@ const std::vector<Vertex>& ChunkMesh::vertices() const
     return m_vertices;
 }
 
+thread_local std::unique_ptr<ChunkMesh::Snapshot> ChunkMesh::s_spareSnapshot;
+
+void ChunkMesh::copyBlocks()
+{
+    if (!m_blocks) {
+        m_blocks = s_spareSnapshot ? std::move(s_spareSnapshot) : std::make_unique<Snapshot>();
+    }
+    m_blocks->copy(*m_chunk, m_detail);
+}
+
 void ChunkMesh::regenerate()
 {
-    m_vertices.clear();
+    build(0);
+}
 
-    for(auto x = 0; x < ChunkData::BLOCKS_X; x++) {
-        for (auto y = 0; y < ChunkData::BLOCKS_Y; y++) {
-            for (auto z = 0; z < ChunkData::BLOCKS_Z; z++) {
+void ChunkMesh::regenerateSections(std::uint64_t sections)
+{
+    assert(canPatch() && m_detail.lod == 0 && sections != 0);
+    build(sections);
+}
+
+void ChunkMesh::build(std::uint64_t sections)
+{
+    // Every meshing thread builds into its own buffer, which keeps its capacity between
+    // chunks, so the chunk itself only ever holds an exactly sized copy of the result.
+    thread_local std::vector<Vertex> s_scratch;
+    const auto scratchCapacity = s_scratch.capacity();
+    s_scratch.clear();
+    if (!m_blocks) {
+        copyBlocks();
+    }
+    addVertices(s_scratch, sections);
+    if (!s_spareSnapshot) {
+        s_spareSnapshot = std::move(m_blocks);
+    }
+    m_blocks.reset();
+    trackMemory(std::ptrdiff_t((s_scratch.capacity() - scratchCapacity) * sizeof(Vertex)));
+
+    m_patchedSections = sections;
+    layoutVertices(s_scratch, sections == 0 && canPatch() && m_detail.lod == 0);
+}
 
-                const BlockType typ = m_chunk->get(x,y,z);
+void ChunkMesh::layoutVertices(const std::vector<Vertex>& faces, bool withSpareCapacity)
+{
+    // Group the faces by direction, so the renderer can skip the directions facing away from the
+    // camera, and by the section of their block, so an edit only touches a few slots
+    thread_local std::vector<std::uint16_t> s_slots;
+    s_slots.resize(faces.size() / numVertices);
+    for (auto& slot : m_layout) {
+        slot = {};
+    }
+    for (std::size_t face = 0; face < s_slots.size(); face++) {
+        const auto* const corners = &faces[face * numVertices];
+        const auto dir = corners[0].normal();
+        auto block = glm::ivec3{ int(corners[0].x()), int(corners[0].y()), int(corners[0].z()) };
+        for (std::size_t i = 1; i < numVertices; i++) {
+            block = glm::min(block, glm::ivec3{ int(corners[i].x()), int(corners[i].y()), int(corners[i].z()) });
+        }
+        // Faces pointing to +X/+Y/+Z lie on the far side of their block
+        if (dir % 2 == 1) {
+            block[int(dir / 2)]--;
+        }
+
+        constexpr auto extent = ChunkData::SECTION_EXTENT;
+        const auto section = block.x / extent + ChunkData::SECTIONS_X * (block.y / extent + ChunkData::SECTIONS_Y * (block.z / extent));
+        const auto slot = std::size_t(dir) * MESH_SLOTS_PER_DIRECTION + std::size_t(section);
+        s_slots[face] = std::uint16_t(slot);
+        m_layout.at(slot).count += numVertices;
+    }
+
+    // Room for a few edits before the chunk has to be meshed again. Slots without faces get room
+    // for one, so a block placed into an empty section fits as well. Chunks without any faces,
+    // which are mostly far below or above the surface, get no room at all.
+    m_patchable = withSpareCapacity;
+    withSpareCapacity = withSpareCapacity && !s_slots.empty();
+    std::uint32_t offset = 0;
+    for (auto& meshSlot : m_layout) {
+        meshSlot.offset = offset;
+        meshSlot.capacity = meshSlot.count;
+        if (withSpareCapacity) {
+            const auto spareFaces = meshSlot.count == 0 ? 1 : meshSlot.count / numVertices / 8 + 2;
+            meshSlot.capacity += spareFaces * numVertices;
+        }
+        offset += meshSlot.capacity;
+    }
+    for (std::size_t dir = 0; dir < 6; dir++) {
+        m_ranges.at(dir) = m_layout.at(dir * MESH_SLOTS_PER_DIRECTION).offset;
+    }
+    m_ranges.back() = offset;
+
+    // Unused capacity is filled with quads whose corners all lie on the same point
+    releaseVertices();
+    m_vertices.resize(offset, Vertex{});
+    auto next = std::array<std::uint32_t, std::tuple_size_v<MeshLayout>> {};
+    for (std::size_t slot = 0; slot < m_layout.size(); slot++) {
+        next.at(slot) = m_layout.at(slot).offset;
+    }
+    for (std::size_t face = 0; face < s_slots.size(); face++) {
+        auto& target = next.at(s_slots[face]);
+        std::copy_n(faces.begin() + std::ptrdiff_t(face * numVertices), numVertices, m_vertices.begin() + target);
+        target += numVertices;
+    }
+    trackMemory(std::ptrdiff_t(m_vertices.capacity() * sizeof(Vertex)));
+}
 
-                if (typ == BlockType::AIR){
+void ChunkMesh::releaseVertices()
+{
+    trackMemory(-std::ptrdiff_t(m_vertices.capacity() * sizeof(Vertex)));
+    m_vertices = {};
+}
+
+MeshMemoryStats ChunkMesh::memoryStats()
+{
+    return { s_memory.load(), s_peakMemory.load() };
+}
+
+void ChunkMesh::trackMemory(std::ptrdiff_t bytes)
+{
+    const auto memory = s_memory.fetch_add(std::size_t(bytes)) + std::size_t(bytes);
+    auto peak = s_peakMemory.load();
+    while (memory > peak && !s_peakMemory.compare_exchange_weak(peak, memory)) {
+    }
+}
+
+void ChunkMesh::addVertices(std::vector<Vertex>& vertices, std::uint64_t sections)
+{
+    // Mesh from a copy, so the chunk only has to stay unchanged while it is copied
+    const auto& blocks = *m_blocks;
+    const auto uniformType = blocks.uniformType;
+    if (uniformType == BlockType::AIR) {
+        return;
+    }
+
+    if (m_detail.lod > 0) {
+        regenerateCoarse(vertices, blocks);
+        return;
+    }
+
+    if (sections != 0) {
+        // The naive and binary meshers emit the same faces, so patch with the faster one
+        constexpr auto extent = ChunkData::SECTION_EXTENT;
+        for (auto remaining = sections; remaining != 0; remaining &= remaining - 1) {
+            const auto section = std::countr_zero(remaining);
+            const auto sx = section % ChunkData::SECTIONS_X;
+            const auto sy = section / ChunkData::SECTIONS_X % ChunkData::SECTIONS_Y;
+            const auto sz = section / (ChunkData::SECTIONS_X * ChunkData::SECTIONS_Y);
+            const auto xMask = ((std::uint64_t{1} << extent) - 1) << (sx * extent);
+            for (auto z = sz * extent; z < (sz + 1) * extent; z++) {
+                for (auto y = sy * extent; y < (sy + 1) * extent; y++) {
+                    addRowFaces(vertices, blocks, y, z, xMask);
+                }
+            }
+        }
+        return;
+    }
+
+    const auto mode = s_mode.load();
+    // The greedy mesher merges the border faces of uniform chunks as well
+    if (uniformType && mode != MeshingMode::Greedy) {
+        addBorderFaces(vertices, blocks, *uniformType);
+        return;
+    }
+
+    switch (mode) {
+        case MeshingMode::Naive: regenerateNaive(vertices, blocks); break;
+        case MeshingMode::Binary: regenerateBinary(vertices, blocks); break;
+        case MeshingMode::Greedy: regenerateGreedy(vertices, blocks); break;
+    }
+}
+
+void ChunkMesh::setMode(MeshingMode mode)
+{
+    s_mode = mode;
+}
+
+MeshingMode ChunkMesh::mode()
+{
+    return s_mode.load();
+}
+
+void ChunkMesh::regenerateNaive(std::vector<Vertex>& vertices, const Snapshot& blocks)
+{
+    constexpr auto extent = ChunkData::SECTION_EXTENT;
+    for (auto sx = 0; sx < ChunkData::SECTIONS_X; sx++) {
+        for (auto sy = 0; sy < ChunkData::SECTIONS_Y; sy++) {
+            for (auto sz = 0; sz < ChunkData::SECTIONS_Z; sz++) {
+                // Empty sections have no faces and all faces of an enclosed section are hidden
+                const auto section = sx + ChunkData::SECTIONS_X * (sy + ChunkData::SECTIONS_Y * sz);
+                if (((blocks.visibleSections >> section) & 1) == 0) {
                     continue;
                 }
 
-                const auto offset_side = atlasLookup(typ, BlockSide::SIDE);
-                const auto offset_top = atlasLookup(typ, BlockSide::TOP);
-                const auto offset_bottom = atlasLookup(typ, BlockSide::BOTTOM);
-
-                // - X
-                auto negXNeighbor = m_chunk->neighbor(Direction::NegX);
-                bool negXCond = x != 0 ? m_chunk->get(x-1,y,z) == BlockType::AIR : (negXNeighbor ? negXNeighbor->get(ChunkData::BLOCKS_X - 1, y, z) == BlockType::AIR : true);
-                if (negXCond) {
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 0), glm::vec3(x, y, z) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 1), glm::vec3(x, y, z + 1) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 2), glm::vec3(x, y + 1, z) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 3), glm::vec3(x, y + 1, z) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 4), glm::vec3(x, y, z + 1) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 5), glm::vec3(x, y + 1, z + 1) });
+                for (auto x = sx * extent; x < (sx + 1) * extent; x++) {
+                    for (auto y = sy * extent; y < (sy + 1) * extent; y++) {
+                        for (auto z = sz * extent; z < (sz + 1) * extent; z++) {
+                            addBlockFaces(vertices, blocks, x, y, z);
+                        }
+                    }
                 }
+            }
+        }
+    }
+}
 
-                // + X
-                auto posXNeighbor = m_chunk->neighbor(Direction::PlusX);
-                bool posXCond = x != ChunkData::BLOCKS_X - 1 ? m_chunk->get(x+1,y,z) == BlockType::AIR : (posXNeighbor ? posXNeighbor->get(0, y, z) == BlockType::AIR : true);
-                if (posXCond) {
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 0), glm::vec3(x + 1, y, z + 1) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 1), glm::vec3(x + 1, y, z) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 2), glm::vec3(x + 1, y + 1, z + 1) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 3), glm::vec3(x + 1, y + 1, z + 1) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 4), glm::vec3(x + 1, y, z) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 5), glm::vec3(x + 1, y + 1, z) });
+void ChunkMesh::regenerateBinary(std::vector<Vertex>& vertices, const Snapshot& blocks)
+{
+    for (auto z = 0; z < ChunkData::BLOCKS_Z; z++) {
+        for (auto y = 0; y < ChunkData::BLOCKS_Y; y++) {
+            addRowFaces(vertices, blocks, y, z, ~std::uint64_t{0});
+        }
+    }
+}
+
+void ChunkMesh::regenerateCoarse(std::vector<Vertex>& vertices, const Snapshot& blocks)
+{
+    const auto scale = 1 << m_detail.lod;
+    const auto cells = ChunkData::BLOCKS_X / scale;
+    const auto uniformType = blocks.uniformType;
+
+    thread_local CoarseGrid s_grid;
+    s_grid.solidRows.fill(0);
+    s_grid.types.fill(0);
+
+    const auto snapshotRow = [&blocks](int y, int z) { return blocks.solidRow(y, z); };
+    for (auto z = 0; z < cells; z++) {
+        for (auto y = 0; y < cells; y++) {
+            auto& row = s_grid.solidRows[CoarseGrid::rowIndex(y, z)];
+            auto blockRows = std::uint64_t{0};
+            for (auto dz = 0; dz < scale; dz++) {
+                for (auto dy = 0; dy < scale; dy++) {
+                    blockRows |= blocks.solidRow(y * scale + dy, z * scale + dz);
+                }
+            }
+            if (blockRows == 0) {
+                continue;
+            }
+            for (auto x = 0; x < cells; x++) {
+                if (isSolidCell(solidBlocks(snapshotRow, x * scale, y * scale, z * scale, scale), scale)) {
+                    row |= std::uint64_t{1} << (x + 1);
                 }
+            }
+        }
+    }
 
-                // - Y
-                auto negYNeighbor = m_chunk->neighbor(Direction::NegY);
-                bool negYCond = y != 0 ? m_chunk->get(x,y-1,z) == BlockType::AIR : (negYNeighbor ? negYNeighbor->get(x, ChunkData::BLOCKS_Y - 1, z) == BlockType::AIR : true);
-                if (negYCond) {
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_bottom + 0), glm::vec3(x, y, z + 1) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_bottom + 1), glm::vec3(x, y, z) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_bottom + 2), glm::vec3(x + 1, y, z + 1) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_bottom + 3), glm::vec3(x + 1, y, z + 1) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_bottom + 4), glm::vec3(x, y, z) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_bottom + 5), glm::vec3(x + 1, y, z) });
+    // A solid cell takes the most common solid type among its blocks. Only cells with a visible
+    // face need one.
+    std::array<int, numBlockTypes> typeCounts {};
+    const auto cellType = [&](int x, int y, int z) {
+        auto& type = s_grid.types[std::size_t(x + cells * (y + cells * z))];
+        if (type != 0) {
+            return BlockType(type);
+        }
+        if (uniformType) {
+            type = std::uint8_t(*uniformType);
+            return BlockType(type);
+        }
+        typeCounts.fill(0);
+        for (auto dz = 0; dz < scale; dz++) {
+            for (auto dy = 0; dy < scale; dy++) {
+                for (auto dx = 0; dx < scale; dx++) {
+                    typeCounts[blocks.blocks[Snapshot::blockIndex(x * scale + dx, y * scale + dy, z * scale + dz)]]++;
                 }
+            }
+        }
+        typeCounts[Snapshot::air] = 0;
+        type = std::uint8_t(std::max_element(typeCounts.begin(), typeCounts.end()) - typeCounts.begin());
+        return BlockType(type);
+    };
 
-                // + Y
-                auto posYNeighbor = m_chunk->neighbor(Direction::PlusY);
-                bool posYCond = y != ChunkData::BLOCKS_Y - 1 ? m_chunk->get(x,y+1,z) == BlockType::AIR : (posYNeighbor ? posYNeighbor->get(x, 0, z) == BlockType::AIR : true);
-                if (posYCond) {
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_top + 0), glm::vec3(x, y + 1, z) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_top + 1), glm::vec3(x, y + 1, z + 1) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_top + 2), glm::vec3(x + 1, y + 1, z) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_top + 3), glm::vec3(x + 1, y + 1, z) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_top + 4), glm::vec3(x, y + 1, z + 1) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_top + 5), glm::vec3(x + 1, y + 1, z + 1) });
+    // The border cells, downsampled from the layer of cells of every neighbor touching the chunk.
+    // Only their solid state matters.
+    for (std::size_t dir = 0; dir < 6; dir++) {
+        const auto axis = int(dir / 2);
+        const auto positive = dir % 2 == 1;
+        for (auto b = 0; b < cells; b++) {
+            for (auto row = blocks.coarseBorder[dir * CoarseGrid::MAX_CELLS + std::size_t(b)]; row != 0; row &= row - 1) {
+                auto cell = glm::ivec3{};
+                cell[axis] = positive ? cells : -1;
+                cell[(axis + 1) % 3] = std::countr_zero(row);
+                cell[(axis + 2) % 3] = b;
+                s_grid.solidRows[CoarseGrid::rowIndex(cell.y, cell.z)] |= std::uint64_t{1} << (cell.x + 1);
+            }
+        }
+    }
+
+    const auto inner = ((std::uint64_t{1} << cells) - 1) << 1;
+    for (auto z = 0; z < cells; z++) {
+        for (auto y = 0; y < cells; y++) {
+            const auto row = s_grid.solidRows[CoarseGrid::rowIndex(y, z)];
+            if ((row & inner) == 0) {
+                continue;
+            }
+
+            const std::array<std::uint64_t, 6> faces {
+                row & ~(row << 1),
+                row & ~(row >> 1),
+                row & ~s_grid.solidRows[CoarseGrid::rowIndex(y - 1, z)],
+                row & ~s_grid.solidRows[CoarseGrid::rowIndex(y + 1, z)],
+                row & ~s_grid.solidRows[CoarseGrid::rowIndex(y, z - 1)],
+                row & ~s_grid.solidRows[CoarseGrid::rowIndex(y, z + 1)],
+            };
+            for (std::size_t dir = 0; dir < faces.size(); dir++) {
+                for (auto visible = faces[dir] & inner; visible != 0; visible &= visible - 1) {
+                    const auto x = std::countr_zero(visible) - 1;
+                    emitQuad(vertices, Direction(dir), glm::ivec3{ x, y, z } * scale, glm::ivec3{ scale }, tileLookup(cellType(x, y, z), sideOf(Direction(dir))));
                 }
+            }
+        }
+    }
+}
+
+void ChunkMesh::addRowFaces(std::vector<Vertex>& vertices, const Snapshot& blocks, int y, int z, std::uint64_t xMask)
+{
+    if ((blocks.solidRow(y, z) & xMask) == 0) {
+        return;
+    }
 
-                // - Z
-                auto negZNeighbor = m_chunk->neighbor(Direction::NegZ);
-                bool negZCond = z != 0 ? m_chunk->get(x,y,z-1) == BlockType::AIR : (negZNeighbor ? negZNeighbor->get(x, y, ChunkData::BLOCKS_Z - 1) == BlockType::AIR : true);
-                if (negZCond) {
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 0), glm::vec3(x + 1, y, z) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 1), glm::vec3(x, y, z) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 2), glm::vec3(x + 1, y + 1, z) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 3), glm::vec3(x + 1, y + 1, z) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 4), glm::vec3(x, y, z) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 5), glm::vec3(x, y + 1, z) });
+    const auto faces = visibleFaces(blocks, y, z);
+    auto visible = (faces[0] | faces[1] | faces[2] | faces[3] | faces[4] | faces[5]) & xMask;
+    while (visible != 0) {
+        const auto x = std::countr_zero(visible);
+        visible &= visible - 1;
+
+        const auto pos = glm::ivec3{x, y, z};
+        const auto typ = blocks.get(x, y, z);
+        for (std::size_t dir = 0; dir < faces.size(); dir++) {
+            if (((faces[dir] >> x) & 1) != 0) {
+                emitFace(vertices, Direction(dir), pos, typ);
+            }
+        }
+    }
+}
+
+void ChunkMesh::regenerateGreedy(std::vector<Vertex>& vertices, const Snapshot& blocks)
+{
+    static_assert(ChunkData::BLOCKS_X == ChunkData::BLOCKS_Y && ChunkData::BLOCKS_X == ChunkData::BLOCKS_Z,
+        "Greedy meshing sweeps square slices");
+    constexpr auto extent = ChunkData::BLOCKS_X;
+
+    // Visible faces of every row, indexed by [Direction][y + BLOCKS_Y * z]
+    thread_local std::array<std::array<std::uint64_t, ChunkData::SOLID_MASK_WORDS>, 6> s_faceRows;
+    // Tile + 1 of every visible face for one direction, 0 where there is no face.
+    // Laid out as [slice along the normal][v][u] so every slice is a contiguous 2D grid.
+    thread_local std::array<std::uint8_t, ChunkData::BLOCKS> s_faceTiles;
+
+    for (auto z = 0; z < ChunkData::BLOCKS_Z; z++) {
+        for (auto y = 0; y < ChunkData::BLOCKS_Y; y++) {
+            const auto faces = blocks.solidRow(y, z) != 0 ? visibleFaces(blocks, y, z) : std::array<std::uint64_t, 6>{};
+            for (std::size_t dir = 0; dir < faces.size(); dir++) {
+                s_faceRows.at(dir).at(std::size_t(y + ChunkData::BLOCKS_Y * z)) = faces.at(dir);
+            }
+        }
+    }
+
+    for (std::size_t dir = 0; dir < 6; dir++) {
+        const auto& axes = planeAxes.at(dir / 2);
+        const auto side = sideOf(Direction(dir));
+
+        auto hasFaces = false;
+        std::array<bool, extent> sliceHasFaces {};
+        for (auto z = 0; z < ChunkData::BLOCKS_Z; z++) {
+            for (auto y = 0; y < ChunkData::BLOCKS_Y; y++) {
+                auto faces = s_faceRows.at(dir).at(std::size_t(y + ChunkData::BLOCKS_Y * z));
+                if (faces != 0 && !hasFaces) {
+                    s_faceTiles.fill(0);
+                    hasFaces = true;
+                }
+                while (faces != 0) {
+                    const auto x = std::countr_zero(faces);
+                    faces &= faces - 1;
+
+                    const auto pos = glm::ivec3{x, y, z};
+                    const auto index = pos[axes.u] + extent * (pos[axes.v] + extent * pos[axes.normal]);
+                    s_faceTiles.at(std::size_t(index)) = std::uint8_t(tileLookup(blocks.get(x, y, z), side) + 1);
+                    sliceHasFaces.at(std::size_t(pos[axes.normal])) = true;
                 }
+            }
+        }
+        if (!hasFaces) {
+            continue;
+        }
+
+        // Grow every face first along u and then along v while the tiles match,
+        // clearing the merged faces so they are only emitted once.
+        for (auto slice = 0; slice < extent; slice++) {
+            if (!sliceHasFaces.at(std::size_t(slice))) {
+                continue;
+            }
+            auto* const grid = &s_faceTiles.at(std::size_t(slice * extent * extent));
+            for (auto v = 0; v < extent; v++) {
+                for (auto u = 0; u < extent; u++) {
+                    const auto tile = grid[u + extent * v];
+                    if (tile == 0) {
+                        continue;
+                    }
 
-                // + Z
-                auto posZNeighbor = m_chunk->neighbor(Direction::PlusZ);
-                bool posZCond = z != ChunkData::BLOCKS_Z - 1 ? m_chunk->get(x,y,z+1) == BlockType::AIR : (posZNeighbor ? posZNeighbor->get(x, y, 0) == BlockType::AIR : true);
-                if (posZCond) {
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 0), glm::vec3(x, y, z + 1) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 1), glm::vec3(x + 1, y, z + 1) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 2), glm::vec3(x, y + 1, z + 1) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 3), glm::vec3(x, y + 1, z + 1) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 4), glm::vec3(x + 1, y, z + 1) });
-                    m_vertices.emplace_back(Vertex { texLookup.at(offset_side + 5), glm::vec3(x + 1, y + 1, z + 1) });
+                    auto width = 1;
+                    while (u + width < extent && grid[u + width + extent * v] == tile) {
+                        width++;
+                    }
+
+                    auto height = 1;
+                    while (v + height < extent) {
+                        const auto* const row = grid + extent * (v + height);
+                        if (!std::all_of(row + u, row + u + width, [tile](std::uint8_t other) { return other == tile; })) {
+                            break;
+                        }
+                        height++;
+                    }
+
+                    for (auto dv = 0; dv < height; dv++) {
+                        std::fill_n(grid + u + extent * (v + dv), width, std::uint8_t{0});
+                    }
+
+                    glm::ivec3 pos;
+                    pos[axes.normal] = slice;
+                    pos[axes.u] = u;
+                    pos[axes.v] = v;
+                    glm::ivec3 size{1, 1, 1};
+                    size[axes.u] = width;
+                    size[axes.v] = height;
+                    emitQuad(vertices, Direction(dir), pos, size, std::uint8_t(tile - 1));
                 }
             }
         }
     }
 }
+
+std::array<std::uint64_t, 6> ChunkMesh::visibleFaces(const Snapshot& blocks, int y, int z)
+{
+    const auto row = Snapshot::rowIndex(y, z);
+    const auto solid = blocks.solidRows[row];
+
+    // Solid bits of the blocks next to every block of the row
+    const auto negXRow = (solid << 1) | blocks.negXEdge[row];
+    const auto posXRow = (solid >> 1) | (blocks.posXEdge[row] << 63);
+    const auto negYRow = blocks.solidRows[row - 1];
+    const auto posYRow = blocks.solidRows[row + 1];
+    const auto negZRow = blocks.solidRows[row - Snapshot::EXTENT];
+    const auto posZRow = blocks.solidRows[row + Snapshot::EXTENT];
+
+    return {
+        solid & ~negXRow,
+        solid & ~posXRow,
+        solid & ~negYRow,
+        solid & ~posYRow,
+        solid & ~negZRow,
+        solid & ~posZRow,
+    };
+}
+
+void ChunkMesh::addBlockFaces(std::vector<Vertex>& vertices, const Snapshot& blocks, int x, int y, int z)
+{
+    if (!blocks.isSolid(x, y, z)) {
+        return;
+    }
+
+    const BlockType typ = blocks.get(x, y, z);
+
+    const auto pos = glm::ivec3{x, y, z};
+
+    // - X
+    if (!blocks.isSolid(x - 1, y, z)) {
+        emitFace(vertices, Direction::NegX, pos, typ);
+    }
+
+    // + X
+    if (!blocks.isSolid(x + 1, y, z)) {
+        emitFace(vertices, Direction::PlusX, pos, typ);
+    }
+
+    // - Y
+    if (!blocks.isSolid(x, y - 1, z)) {
+        emitFace(vertices, Direction::NegY, pos, typ);
+    }
+
+    // + Y
+    if (!blocks.isSolid(x, y + 1, z)) {
+        emitFace(vertices, Direction::PlusY, pos, typ);
+    }
+
+    // - Z
+    if (!blocks.isSolid(x, y, z - 1)) {
+        emitFace(vertices, Direction::NegZ, pos, typ);
+    }
+
+    // + Z
+    if (!blocks.isSolid(x, y, z + 1)) {
+        emitFace(vertices, Direction::PlusZ, pos, typ);
+    }
+}
+
+void ChunkMesh::addBorderFaces(std::vector<Vertex>& vertices, const Snapshot& blocks, BlockType type)
+{
+    // Faces between the blocks of a uniform chunk are never visible, only its outer shell can be
+    constexpr auto maxX = ChunkData::BLOCKS_X - 1;
+    constexpr auto maxY = ChunkData::BLOCKS_Y - 1;
+    constexpr auto maxZ = ChunkData::BLOCKS_Z - 1;
+
+    for (auto y = 0; y < ChunkData::BLOCKS_Y; y++) {
+        for (auto z = 0; z < ChunkData::BLOCKS_Z; z++) {
+            if (!blocks.isSolid(-1, y, z)) {
+                emitFace(vertices, Direction::NegX, {0, y, z}, type);
+            }
+            if (!blocks.isSolid(maxX + 1, y, z)) {
+                emitFace(vertices, Direction::PlusX, {maxX, y, z}, type);
+            }
+        }
+    }
+
+    for (auto x = 0; x < ChunkData::BLOCKS_X; x++) {
+        for (auto z = 0; z < ChunkData::BLOCKS_Z; z++) {
+            if (!blocks.isSolid(x, -1, z)) {
+                emitFace(vertices, Direction::NegY, {x, 0, z}, type);
+            }
+            if (!blocks.isSolid(x, maxY + 1, z)) {
+                emitFace(vertices, Direction::PlusY, {x, maxY, z}, type);
+            }
+        }
+    }
+
+    for (auto x = 0; x < ChunkData::BLOCKS_X; x++) {
+        for (auto y = 0; y < ChunkData::BLOCKS_Y; y++) {
+            if (!blocks.isSolid(x, y, -1)) {
+                emitFace(vertices, Direction::NegZ, {x, y, 0}, type);
+            }
+            if (!blocks.isSolid(x, y, maxZ + 1)) {
+                emitFace(vertices, Direction::PlusZ, {x, y, maxZ}, type);
+            }
+        }
+    }
+}
@@ -1,29 +1,184 @@
 #pragma once
 
-#include <glm/ext/vector_float2.hpp>
-#include <glm/ext/vector_uint3_sized.hpp>
+#include <glm/ext/vector_float4.hpp>
+#include <glm/ext/vector_int3.hpp>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <vector>
 
+#include "Vertex.h"
+
 namespace Engine {
 class Chunk;
+enum class BlockType;
+enum class Direction;
+}
+
+
+enum class MeshingMode
+{
+    Naive, // Tests the six neighbors of every block
+    Binary, // Culls faces for a whole row of 64 blocks at once using the chunk's solid mask
+    Greedy, // Merges coplanar faces with the same texture into larger quads
+};
+
+// Offset of the first vertex of every face direction in ChunkMesh::vertices(), indexed by
+// Engine::Direction, followed by the total number of vertices
+using DirectionRanges = std::array<std::uint32_t, 7>;
+
+// Which of the two face directions along one axis can face a camera at coordinate camera, for faces
+// lying in planes within [min, max]. Bit 0 is the negative and bit 1 the positive direction.
+// A face pointing to negative values at plane p is only visible from camera < p.
+[[nodiscard]] constexpr unsigned facingAxisDirections(float min, float max, float camera)
+{
+    return (camera < max ? 1u : 0u) | (camera > min ? 2u : 0u);
+}
+
+// The face directions of a box that can face a camera at camera, one bit per Engine::Direction
+[[nodiscard]] constexpr unsigned facingDirections(float minX, float minY, float minZ,
+                                                  float maxX, float maxY, float maxZ,
+                                                  float cameraX, float cameraY, float cameraZ)
+{
+    return facingAxisDirections(minX, maxX, cameraX)
+        | facingAxisDirections(minY, maxY, cameraY) << 2
+        | facingAxisDirections(minZ, maxZ, cameraZ) << 4;
 }
 
-struct Vertex
+static_assert(facingAxisDirections(0.0f, 64.0f, -10.0f) == 1u, "Only faces pointing to the camera in front of the box");
+static_assert(facingAxisDirections(0.0f, 64.0f, 70.0f) == 2u, "Only faces pointing to the camera behind the box");
+static_assert(facingAxisDirections(0.0f, 64.0f, 32.0f) == 3u, "Both directions from within the box");
+static_assert(facingAxisDirections(0.0f, 64.0f, 64.0f) == 2u, "Faces in the camera's plane are edge-on");
+static_assert(facingAxisDirections(0.0f, 64.0f, 0.0f) == 1u, "Faces in the camera's plane are edge-on");
+static_assert(facingDirections(0, 0, 0, 64, 64, 64, -1, 100, 32) == 0b11'10'01u, "-X, +Y and both Z directions");
+static_assert(facingDirections(0, 0, 0, 64, 64, 64, 10, 20, 30) == 0b11'11'11u, "Everything from inside");
+
+// Where the faces of one direction inside one chunk section live in a chunk's vertex buffer.
+// Vertices past count up to capacity are degenerate quads, left free for patches.
+struct MeshSlot
 {
-    glm::vec2 textureCoord;
-    glm::u8vec3 position;
+    std::uint32_t offset = 0;
+    std::uint32_t count = 0;
+    std::uint32_t capacity = 0;
+};
+
+constexpr std::size_t MESH_SLOTS_PER_DIRECTION = 64; // One per chunk section
+
+// Indexed by Direction * MESH_SLOTS_PER_DIRECTION + section index, see Chunk::section()
+using MeshLayout = std::array<MeshSlot, 6 * MESH_SLOTS_PER_DIRECTION>;
+
+// How coarse a mesh is and which of its borders are seams to a neighbor meshed at another level
+struct MeshDetail
+{
+    std::uint8_t lod = 0; // Faces cover cells of 2^lod blocks per side
+    std::uint8_t seams = 0; // One bit per Engine::Direction
+
+    bool operator==(const MeshDetail&) const = default;
+};
+
+constexpr std::uint8_t MAX_MESH_LOD = 2;
+
+// CPU side vertex memory of all meshes, including the per-thread meshing buffers
+struct MeshMemoryStats
+{
+    std::size_t current = 0;
+    std::size_t peak = 0;
 };
 
 class ChunkMesh
 {
 public:
-    ChunkMesh(Engine::Chunk* chunk);
+    explicit ChunkMesh(Engine::Chunk* chunk, MeshDetail detail = {});
+    ~ChunkMesh();
 
+    // Grouped by face direction, see directionRanges(), and by section within each direction, see layout()
     [[nodiscard]] const std::vector<Vertex>& vertices() const;
+    [[nodiscard]] const DirectionRanges& directionRanges() const { return m_ranges; }
+    [[nodiscard]] const MeshLayout& layout() const { return m_layout; }
+    [[nodiscard]] const MeshDetail& detail() const { return m_detail; }
+
+    // Whether the faces were laid out per section with spare capacity, so patches can rewrite
+    // the slots of this mesh once it is uploaded
+    [[nodiscard]] bool isPatchable() const { return m_patchable; }
+
+    // Copies everything meshing reads from the chunk and its neighbors. Building the mesh afterwards
+    // only reads the copy, so it can run on any thread while the chunk changes or is unloaded.
+    // regenerate() and regenerateSections() copy the blocks themselves if this was not called.
+    void copyBlocks();
 
+    // Meshes the whole chunk. At full detail and outside of greedy mode every slot gets spare
+    // capacity, so later edits can be patched in place. Coarser meshes emit one face per side of
+    // every solid cell, whatever the mode. Faces towards a seam are never culled, which closes the
+    // gaps between the differing surfaces of both levels.
     void regenerate();
 
+    // Only meshes the sections set in the bit mask (bit = section index), for patching the
+    // slots of an existing mesh. Only possible if canPatch() and at full detail.
+    void regenerateSections(std::uint64_t sections);
+
+    // The sections of a patch, 0 for a complete mesh
+    [[nodiscard]] std::uint64_t patchedSections() const { return m_patchedSections; }
+
+    // Greedy quads cross section borders, so their meshes cannot be patched per section
+    [[nodiscard]] static bool canPatch() { return mode() != MeshingMode::Greedy; }
+
+    // Frees the vertices once they have been uploaded to the GPU
+    void releaseVertices();
+
+    [[nodiscard]] static MeshMemoryStats memoryStats();
+
+    // The mode used by all following regenerate() calls
+    static void setMode(MeshingMode mode);
+    [[nodiscard]] static MeshingMode mode();
+
+    // Atlas rectangle (min u, min v, max u, max v) of every block texture, indexed by Vertex::tile()
+    [[nodiscard]] static std::vector<glm::vec4> atlasTiles();
+
 private:
+    // The chunk's blocks plus a one block border from its neighbors, see ChunkMesh.cpp
+    struct Snapshot;
+
+    static void trackMemory(std::ptrdiff_t bytes);
+
+    // Builds a complete mesh for sections == 0 and a patch otherwise
+    void build(std::uint64_t sections);
+    void addVertices(std::vector<Vertex>& vertices, std::uint64_t sections);
+
+    // Sorts the faces into the slots of m_layout and copies them to m_vertices
+    void layoutVertices(const std::vector<Vertex>& faces, bool withSpareCapacity);
+
+    void regenerateNaive(std::vector<Vertex>& vertices, const Snapshot& blocks);
+    void regenerateBinary(std::vector<Vertex>& vertices, const Snapshot& blocks);
+    void regenerateGreedy(std::vector<Vertex>& vertices, const Snapshot& blocks);
+
+    // Visible faces of the row of blocks at (y, z), one bit per block along x, indexed by Direction
+    [[nodiscard]] static std::array<std::uint64_t, 6> visibleFaces(const Snapshot& blocks, int y, int z);
+
+    // Emits the visible faces of the blocks of row (y, z) selected by the bits of xMask
+    static void addRowFaces(std::vector<Vertex>& vertices, const Snapshot& blocks, int y, int z, std::uint64_t xMask);
+
+    // Meshes cells of 2^lod blocks, each of the dominant solid block type of its blocks
+    void regenerateCoarse(std::vector<Vertex>& vertices, const Snapshot& blocks);
+
+    static void addBlockFaces(std::vector<Vertex>& vertices, const Snapshot& blocks, int x, int y, int z);
+
+    // Only emits the outer faces, for chunks made of a single solid block type
+    static void addBorderFaces(std::vector<Vertex>& vertices, const Snapshot& blocks, Engine::BlockType type);
+
     Engine::Chunk* const m_chunk;
+    const MeshDetail m_detail;
+    std::unique_ptr<Snapshot> m_blocks; // From copyBlocks() until the mesh is built
     std::vector<Vertex> m_vertices;
+    DirectionRanges m_ranges {};
+    MeshLayout m_layout {};
+    std::uint64_t m_patchedSections = 0;
+    bool m_patchable = false;
+
+    static std::atomic<MeshingMode> s_mode;
+    static std::atomic<std::size_t> s_memory;
+    static std::atomic<std::size_t> s_peakMemory;
+    // Every thread keeps the snapshot of the last mesh it built for the next one
+    static thread_local std::unique_ptr<Snapshot> s_spareSnapshot;
 };
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "ChunkSection.h"
+#include "Chunk.h"
+
+namespace Engine
+{
+
+ChunkSection::ChunkSection(BlockType type)
+    : m_blocks(ChunkData::SECTION_BLOCKS, type)
+    , m_solidBlocks(type == BlockType::AIR ? 0 : ChunkData::SECTION_BLOCKS)
+{
+}
+
+void ChunkSection::set(int x, int y, int z, BlockType type)
+{
+    const auto index = blockIndex(x, y, z);
+    const auto oldType = m_blocks.get(index);
+    if (oldType == type) {
+        return;
+    }
+
+    if (oldType == BlockType::AIR) {
+        m_solidBlocks++;
+    }
+    else if (type == BlockType::AIR) {
+        m_solidBlocks--;
+    }
+    m_blocks.set(index, type);
+}
+
+std::optional<BlockType> ChunkSection::uniformType() const
+{
+    if (!m_blocks.isUniform()) {
+        return std::nullopt;
+    }
+    return m_blocks.get(0);
+}
+
+std::size_t ChunkSection::memoryUsage() const
+{
+    return sizeof(*this) - sizeof(m_blocks) + m_blocks.memoryUsage();
+}
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+
+#include "BlockStorage.h"
+
+namespace ChunkData
+{
+    constexpr auto SECTION_EXTENT = 16; // The number of blocks along every axis of a chunk section
+    constexpr auto SECTION_BLOCKS = SECTION_EXTENT * SECTION_EXTENT * SECTION_EXTENT;
+}
+
+namespace Engine
+{
+
+    // A 16x16x16 block part of a chunk. Chunks only allocate sections that hold
+    // at least one non-air block.
+    class ChunkSection
+    {
+    public:
+
+        explicit ChunkSection(BlockType type);
+
+        // Coordinates are local to the section
+        [[nodiscard]] BlockType get(int x, int y, int z) const
+        {
+            return m_blocks.get(blockIndex(x, y, z));
+        }
+
+        void set(int x, int y, int z, BlockType type);
+
+        // Copies all blocks into blocks, indexed by x + SECTION_EXTENT * (y + SECTION_EXTENT * z)
+        void copyBlocks(std::span<BlockType, ChunkData::SECTION_BLOCKS> blocks) const
+        {
+            m_blocks.unpack(blocks);
+        }
+
+        [[nodiscard]] bool isEmpty() const { return m_solidBlocks == 0; }
+        [[nodiscard]] bool isFull() const { return m_solidBlocks == ChunkData::SECTION_BLOCKS; }
+
+        // The block type of every block if the section only holds one type
+        [[nodiscard]] std::optional<BlockType> uniformType() const;
+
+        [[nodiscard]] std::size_t memoryUsage() const;
+
+    private:
+
+        static std::size_t blockIndex(int x, int y, int z)
+        {
+            return std::size_t(x + ChunkData::SECTION_EXTENT * (y + ChunkData::SECTION_EXTENT * z));
+        }
+
+        BlockStorage m_blocks;
+        std::size_t m_solidBlocks = 0; // Number of non-air blocks
+    };
+
+}
@@ -0,0 +1,72 @@
+#include "GpuBufferPool.h"
+#include "Vertex.h"
+
+#include <cstddef>
+
+namespace Engine
+{
+
+GpuBufferPool& GpuBufferPool::instance()
+{
+    static GpuBufferPool s_instance;
+    return s_instance;
+}
+
+GpuBuffers GpuBufferPool::acquire()
+{
+    if (!m_pooled.empty()) {
+        const auto buffers = m_pooled.back();
+        m_pooled.pop_back();
+        m_pooledCount = m_pooled.size();
+        m_reused++;
+        return buffers;
+    }
+
+    GpuBuffers buffers;
+    glGenBuffers(1, &buffers.vbo);
+    glGenVertexArrays(1, &buffers.vao);
+
+    glBindVertexArray(buffers.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.vbo);
+    glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, data)));
+    glEnableVertexAttribArray(0);
+    m_created++;
+    return buffers;
+}
+
+void GpuBufferPool::release(const GpuBuffers& buffers)
+{
+    std::unique_lock<std::mutex> lck(m_releasedMutex);
+    m_released.push_back(buffers);
+}
+
+void GpuBufferPool::collect()
+{
+    std::vector<GpuBuffers> released;
+    {
+        std::unique_lock<std::mutex> lck(m_releasedMutex);
+        released.swap(m_released);
+    }
+
+    for (const auto& buffers : released) {
+        if (m_pooled.size() < CAPACITY) {
+            // The next mesh replaces the vertices anyway, so don't keep the GPU memory until then
+            glBindBuffer(GL_ARRAY_BUFFER, buffers.vbo);
+            glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+            m_pooled.push_back(buffers);
+        }
+        else {
+            glDeleteBuffers(1, &buffers.vbo);
+            glDeleteVertexArrays(1, &buffers.vao);
+            m_deleted++;
+        }
+    }
+    m_pooledCount = m_pooled.size();
+}
+
+GpuBufferPool::Stats GpuBufferPool::stats() const
+{
+    return { m_created, m_reused, m_deleted, m_pooledCount };
+}
+
+}
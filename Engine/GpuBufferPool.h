@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include <gl/glew.h>
+
+namespace Engine
+{
+
+    // A vertex array with the vertex buffer it reads its vertices from
+    struct GpuBuffers
+    {
+        GLuint vao = 0;
+        GLuint vbo = 0;
+    };
+
+    // Recycles the vertex arrays and buffers of chunk meshes. Chunks are loaded and unloaded all
+    // the time as the player moves, so the buffers of an unloaded chunk are kept for the next
+    // chunk that uploads a mesh instead of being deleted. Buffers may be released on any thread,
+    // which only queues them. acquire() and collect() call GL and must run on the render thread.
+    class GpuBufferPool
+    {
+    public:
+
+        struct Stats
+        {
+            std::size_t created = 0;
+            std::size_t reused = 0;
+            std::size_t deleted = 0; // Released beyond the capacity of the pool
+            std::size_t pooled = 0;
+        };
+
+        // The pool of the render thread's GL context. Never deletes its GL objects, since the
+        // context is gone by the time it is destroyed.
+        [[nodiscard]] static GpuBufferPool& instance();
+
+        // Pooled buffers if there are any, otherwise new ones. The vertex array reads the vertex
+        // attributes from the vertex buffer.
+        [[nodiscard]] GpuBuffers acquire();
+
+        void release(const GpuBuffers& buffers);
+
+        // Pools the buffers released since the last call, dropping their storage, and deletes the
+        // ones that don't fit. Called once per frame.
+        void collect();
+
+        [[nodiscard]] Stats stats() const;
+
+    private:
+
+        static constexpr std::size_t CAPACITY = 128; // About two rows of chunks along the view distance
+
+        mutable std::mutex m_releasedMutex;
+        std::vector<GpuBuffers> m_released;
+
+        // Only accessed on the render thread
+        std::vector<GpuBuffers> m_pooled;
+
+        std::atomic<std::size_t> m_created = 0;
+        std::atomic<std::size_t> m_reused = 0;
+        std::atomic<std::size_t> m_deleted = 0;
+        std::atomic<std::size_t> m_pooledCount = 0;
+    };
+
+}
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "GpuMesh.h"
+
+namespace
+{
+
+constexpr std::size_t verticesPerQuad = 4;
+constexpr std::size_t indicesPerQuad = 6;
+
+// Index buffer shared by every chunk VAO, turning each group of 4 vertices into the two
+// triangles of a face. It only ever grows and lives as long as the GL context.
+GLuint s_quadIndexBuffer = 0;
+std::size_t s_quadIndexCapacity = 0; // In quads
+
+// Binds the shared quad index buffer to the current VAO, growing it to at least quads faces
+void bindQuadIndices(std::size_t quads)
+{
+    if (s_quadIndexBuffer == 0) {
+        glGenBuffers(1, &s_quadIndexBuffer);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_quadIndexBuffer);
+
+    if (quads <= s_quadIndexCapacity) {
+        return;
+    }
+
+    // Every VAO refers to the buffer by name, so refilling it in place updates all of them
+    const auto capacity = std::max(quads, s_quadIndexCapacity * 2);
+    std::vector<std::uint32_t> indices;
+    indices.reserve(capacity * indicesPerQuad);
+    for (std::size_t quad = 0; quad < capacity; quad++) {
+        const auto first = std::uint32_t(quad * verticesPerQuad);
+        indices.insert(indices.end(), { first, first + 1, first + 2, first + 2, first + 1, first + 3 });
+    }
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(indices.size() * sizeof(std::uint32_t)), indices.data(), GL_STATIC_DRAW);
+    s_quadIndexCapacity = capacity;
+}
+
+}
+
+namespace Engine
+{
+
+GpuMesh::~GpuMesh()
+{
+    // Chunks are unloaded off the render thread, so only queue the buffers for reuse
+    if (m_buffers.vao != 0) {
+        GpuBufferPool::instance().release(m_buffers);
+    }
+}
+
+UploadResult GpuMesh::upload(ChunkMesh& mesh, std::uint64_t sequence)
+{
+    // Meshing jobs may finish out of order, never replace a mesh with an older one
+    if (sequence <= m_meshSequence) {
+        return { UploadStatus::Stale };
+    }
+    if (sequence <= m_patchSequence) {
+        return { UploadStatus::Outdated };
+    }
+    m_meshSequence = sequence;
+    m_patchSequence = 0;
+    m_vertices = mesh.vertices().size();
+    m_ranges = mesh.directionRanges();
+    m_layout = mesh.layout();
+    m_detail = mesh.detail();
+    m_patchable = mesh.isPatchable();
+
+    if (m_buffers.vao == 0) {
+        if (m_vertices == 0) {
+            // Nothing to draw (e.g. uniform or fully enclosed chunks), so no GL objects are needed
+            return {};
+        }
+        m_buffers = GpuBufferPool::instance().acquire();
+    }
+
+    glBindVertexArray(m_buffers.vao);
+    bindQuadIndices(m_vertices / verticesPerQuad);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_buffers.vbo);
+    glBufferData(GL_ARRAY_BUFFER, mesh.vertices().size() * sizeof(Vertex), mesh.vertices().data(), GL_STATIC_DRAW);
+
+    // The GPU owns the vertices now
+    mesh.releaseVertices();
+    return { UploadStatus::Uploaded, m_vertices * sizeof(Vertex) };
+}
+
+UploadResult GpuMesh::patch(ChunkMesh& patch, std::uint64_t sequence)
+{
+    if (sequence <= std::max(m_meshSequence, m_patchSequence)) {
+        return { UploadStatus::Stale };
+    }
+
+    // A patch is either applied completely or not at all, and only to a mesh with slots per
+    // section of the same detail. The meshing mode of the uploaded mesh may differ from the current one.
+    if (!m_patchable || patch.detail() != m_detail) {
+        return { UploadStatus::DoesNotFit };
+    }
+    const auto& patchLayout = patch.layout();
+    const auto isPatched = [&patch](std::size_t slot) {
+        return ((patch.patchedSections() >> (slot % MESH_SLOTS_PER_DIRECTION)) & 1) != 0;
+    };
+    for (std::size_t slot = 0; slot < m_layout.size(); slot++) {
+        if (isPatched(slot) && patchLayout.at(slot).count > m_layout.at(slot).capacity) {
+            return { UploadStatus::DoesNotFit };
+        }
+    }
+    m_patchSequence = sequence;
+
+    std::size_t uploadedBytes = 0;
+    std::vector<Vertex> slotVertices;
+    for (std::size_t slot = 0; slot < m_layout.size(); slot++) {
+        auto& target = m_layout.at(slot);
+        const auto& source = patchLayout.at(slot);
+        // Faces beyond the new count that were in use before become degenerate again
+        const auto written = std::max(target.count, source.count);
+        if (!isPatched(slot) || written == 0) {
+            continue;
+        }
+
+        const auto first = patch.vertices().begin() + source.offset;
+        slotVertices.assign(first, first + source.count);
+        slotVertices.resize(written, Vertex{});
+        glBindBuffer(GL_ARRAY_BUFFER, m_buffers.vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, GLintptr(target.offset * sizeof(Vertex)), GLsizeiptr(written * sizeof(Vertex)), slotVertices.data());
+        target.count = source.count;
+        uploadedBytes += written * sizeof(Vertex);
+    }
+
+    patch.releaseVertices();
+    return { UploadStatus::Uploaded, uploadedBytes };
+}
+
+std::size_t GpuMesh::render(const glm::vec3& min, const glm::vec3& max, const glm::vec3& cameraPos, GLuint texture) const
+{
+    if (m_vertices == 0) {
+        return 0;
+    }
+
+    const auto directions = facingDirections(min.x, min.y, min.z, max.x, max.y, max.z, cameraPos.x, cameraPos.y, cameraPos.z);
+
+    // One draw range per facing direction, merging directions that are next to each other in the buffer
+    std::array<GLsizei, 6> counts {};
+    std::array<std::size_t, 6> firstIndices {};
+    GLsizei draws = 0;
+    for (std::size_t dir = 0; dir < 6; dir++) {
+        const auto firstIndex = m_ranges.at(dir) / verticesPerQuad * indicesPerQuad;
+        const auto count = GLsizei((m_ranges.at(dir + 1) - m_ranges.at(dir)) / verticesPerQuad * indicesPerQuad);
+        if (((directions >> dir) & 1) == 0 || count == 0) {
+            continue;
+        }
+
+        if (draws > 0 && firstIndices.at(draws - 1) + std::size_t(counts.at(draws - 1)) == firstIndex) {
+            counts.at(draws - 1) += count;
+        }
+        else {
+            firstIndices.at(draws) = firstIndex;
+            counts.at(draws) = count;
+            draws++;
+        }
+    }
+    if (draws == 0) {
+        return 0;
+    }
+
+    std::array<const void*, 6> offsets {};
+    std::size_t drawnIndices = 0;
+    for (GLsizei i = 0; i < draws; i++) {
+        offsets.at(i) = reinterpret_cast<const void*>(firstIndices.at(i) * sizeof(std::uint32_t));
+        drawnIndices += std::size_t(counts.at(i));
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    glBindVertexArray(m_buffers.vao);
+
+    glMultiDrawElements(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), draws);
+
+    return drawnIndices / indicesPerQuad * verticesPerQuad;
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <gl/glew.h>
+#include <glm/glm.hpp>
+
+#include "ChunkMesh.h"
+#include "GpuBufferPool.h"
+
+namespace Engine
+{
+
+    enum class UploadStatus
+    {
+        Uploaded,
+        Stale, // A newer mesh is already shown, nothing was uploaded
+        // Only for complete meshes: a patch of newer blocks is already shown, which the mesh lacks.
+        // Its other changes would be lost though, so the chunk needs a new complete mesh.
+        Outdated,
+        DoesNotFit, // Only for patches, the chunk needs a complete mesh
+    };
+
+    struct UploadResult
+    {
+        UploadStatus status = UploadStatus::Uploaded;
+        std::size_t bytes = 0;
+    };
+
+    // The uploaded mesh of a chunk. Keeps the GPU resources apart from the blocks, so a chunk can
+    // be destroyed on any thread: the buffers go back to the GpuBufferPool, which reuses them for
+    // the next mesh on the render thread. Everything except the destructor must be called on the
+    // render thread.
+    class GpuMesh
+    {
+    public:
+
+        GpuMesh() = default;
+        ~GpuMesh();
+
+        GpuMesh(const GpuMesh&) = delete;
+        GpuMesh& operator=(const GpuMesh&) = delete;
+
+        // Uploads a mesh built by a meshing job, unless a newer mesh or patch is already shown.
+        // sequence orders meshes and patches by the blocks they were built from.
+        UploadResult upload(ChunkMesh& mesh, std::uint64_t sequence);
+
+        // Rewrites the slots of the sections in a patch built by ChunkMesh::regenerateSections().
+        // Does not change anything if the uploaded mesh is not patchable, has another detail or
+        // a slot lacks the capacity.
+        UploadResult patch(ChunkMesh& patch, std::uint64_t sequence);
+
+        // Only draws the faces that can point to the camera, given the bounds of the chunk.
+        // Returns the number of drawn vertices.
+        std::size_t render(const glm::vec3& min, const glm::vec3& max, const glm::vec3& cameraPos, GLuint texture) const;
+
+        [[nodiscard]] std::size_t vertexCount() const { return m_vertices; }
+        [[nodiscard]] const MeshDetail& detail() const { return m_detail; }
+
+        // False until the first mesh of the chunk arrives
+        [[nodiscard]] bool isUploaded() const { return m_meshSequence != 0; }
+
+    private:
+
+        GpuBuffers m_buffers {};
+        std::size_t m_vertices = 0;
+        DirectionRanges m_ranges {};
+        MeshLayout m_layout {};
+        MeshDetail m_detail {};
+        bool m_patchable = false;
+        std::uint64_t m_meshSequence = 0; // Of the complete mesh
+        std::uint64_t m_patchSequence = 0; // Of the latest patch applied to it, if newer
+    };
+}
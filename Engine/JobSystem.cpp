@@ -0,0 +1,126 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+    // The pool and worker the current thread belongs to, if any
+    thread_local const JobSystem* t_pool = nullptr;
+    thread_local std::size_t t_worker = 0;
+}
+
+JobSystem::JobSystem(std::size_t workerCount)
+{
+    workerCount = std::max<std::size_t>(workerCount, 1);
+    for (std::size_t i = 0; i < workerCount; i++) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+    // Only start the threads once every worker exists, since they steal from each other
+    for (std::size_t i = 0; i < workerCount; i++) {
+        m_workers[i]->thread = std::thread([this, i]() { run(i); });
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::unique_lock<std::mutex> lck(m_stateMutex);
+        m_stopping = true;
+    }
+    m_jobQueued.notify_all();
+    for (auto& worker : m_workers) {
+        worker->thread.join();
+    }
+}
+
+JobSystem& JobSystem::instance()
+{
+    static JobSystem s_instance;
+    return s_instance;
+}
+
+std::size_t JobSystem::defaultWorkerCount()
+{
+    const auto hardwareThreads = std::size_t(std::thread::hardware_concurrency());
+    return hardwareThreads > 3 ? hardwareThreads - 2 : 1;
+}
+
+void JobSystem::submit(Job job)
+{
+    const auto worker = t_pool == this ? t_worker : m_nextWorker++ % m_workers.size();
+    {
+        std::unique_lock<std::mutex> lck(m_workers[worker]->mutex);
+        m_workers[worker]->jobs.push_back(std::move(job));
+    }
+    {
+        std::unique_lock<std::mutex> lck(m_stateMutex);
+        m_queuedJobs++;
+        m_unfinishedJobs++;
+    }
+    m_jobQueued.notify_one();
+}
+
+void JobSystem::wait()
+{
+    assert(t_pool != this && "A job waiting for all jobs waits for itself");
+    std::unique_lock<std::mutex> lck(m_stateMutex);
+    m_jobsFinished.wait(lck, [this]() { return m_unfinishedJobs == 0; });
+}
+
+void JobSystem::run(std::size_t worker)
+{
+    t_pool = this;
+    t_worker = worker;
+
+    while (true) {
+        // Claim one of the queued jobs first, so a worker only searches the deques if one is there
+        {
+            std::unique_lock<std::mutex> lck(m_stateMutex);
+            m_jobQueued.wait(lck, [this]() { return m_queuedJobs > 0 || m_stopping; });
+            if (m_queuedJobs == 0) {
+                return;
+            }
+            m_queuedJobs--;
+        }
+
+        // Every claimed job is in some deque, but another worker may take it while this one looks
+        // through the others, in which case the job that worker claimed is left for this one
+        auto job = take(worker);
+        while (!job) {
+            std::this_thread::yield();
+            job = take(worker);
+        }
+        job();
+
+        std::unique_lock<std::mutex> lck(m_stateMutex);
+        if (--m_unfinishedJobs == 0) {
+            m_jobsFinished.notify_all();
+        }
+    }
+}
+
+JobSystem::Job JobSystem::take(std::size_t worker)
+{
+    {
+        auto& own = *m_workers[worker];
+        std::unique_lock<std::mutex> lck(own.mutex);
+        if (!own.jobs.empty()) {
+            auto job = std::move(own.jobs.front());
+            own.jobs.pop_front();
+            return job;
+        }
+    }
+
+    for (std::size_t i = 1; i < m_workers.size(); i++) {
+        auto& victim = *m_workers[(worker + i) % m_workers.size()];
+        std::unique_lock<std::mutex> lck(victim.mutex);
+        if (!victim.jobs.empty()) {
+            auto job = std::move(victim.jobs.back());
+            victim.jobs.pop_back();
+            m_stolenJobs++;
+            return job;
+        }
+    }
+    return {};
+}
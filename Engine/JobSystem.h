@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A pool of worker threads running jobs. Every worker has its own deque of jobs: it runs them in
+// the order they were queued and, once it runs out, steals the most recently queued job of
+// another worker. Jobs submitted from outside the pool are spread over the workers in turn, jobs
+// submitted by a job go to the deque of the worker running it.
+class JobSystem
+{
+public:
+    using Job = std::function<void()>;
+
+    explicit JobSystem(std::size_t workerCount = defaultWorkerCount());
+    ~JobSystem(); // Runs the queued jobs before joining the workers
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // The pool shared by the engine
+    [[nodiscard]] static JobSystem& instance();
+
+    // One worker per hardware thread, less the main and chunk manager threads
+    [[nodiscard]] static std::size_t defaultWorkerCount();
+
+    void submit(Job job);
+
+    // Blocks until every submitted job, including the ones submitted meanwhile, has finished
+    void wait();
+
+    [[nodiscard]] std::size_t workerCount() const { return m_workers.size(); }
+    [[nodiscard]] std::size_t stolenJobs() const { return m_stolenJobs; }
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+        std::thread thread;
+    };
+
+    void run(std::size_t worker);
+
+    // Takes the next job of the worker, or steals one. Returns an empty job if all deques are empty.
+    Job take(std::size_t worker);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<std::size_t> m_nextWorker = 0; // Receives the next job submitted from outside
+
+    // Jobs queued but not yet taken, and jobs not yet finished
+    std::mutex m_stateMutex;
+    std::condition_variable m_jobQueued;
+    std::condition_variable m_jobsFinished;
+    std::size_t m_queuedJobs = 0;
+    std::size_t m_unfinishedJobs = 0;
+    bool m_stopping = false;
+
+    std::atomic<std::size_t> m_stolenJobs = 0;
+};
@@ -94,4 +94,9 @@ namespace Engine
         glUniformMatrix4fv(glGetUniformLocation(this->id, name.c_str()), 1, false, glm::value_ptr(value));
     }
 
+    void Shader::setUniform(const std::string &name, const std::vector<glm::vec4>& values) const
+    {
+        glUniform4fv(glGetUniformLocation(this->id, name.c_str()), GLsizei(values.size()), glm::value_ptr(values.front()));
+    }
+
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <SDL2/SDL_opengl.h>
 
 #include <string>
+#include <vector>
 
 namespace Engine
 {
@@ -28,6 +29,7 @@ public:
     void setUniform(const std::string& name, int value) const;
     void setUniform(const std::string& name, float value) const;
     void setUniform(const std::string& name, glm::mat4 value) const;
+    void setUniform(const std::string& name, const std::vector<glm::vec4>& values) const;
 private:
 
     void loadShader(const std::string& path, Type shaderType);
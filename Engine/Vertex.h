@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+
+// A chunk mesh vertex packed into 32 bits:
+//   bits  0-20  x, y, z, 7 bits each, the position in the chunk in [0, 64]
+//   bits 21-23  normal, the Engine::Direction the face points to
+//   bits 24-25  corner, which of the four corners of the face this is
+//   bits 26-31  tile, index into ChunkMesh::atlasTiles()
+// The vertex shader rebuilds the texture coordinate from position and normal, so a face merged
+// over several blocks repeats its texture once per block. Must match shaders/shader.vert.
+struct Vertex
+{
+    static constexpr std::uint32_t POSITION_BITS = 7;
+    static constexpr std::uint32_t NORMAL_BITS = 3;
+    static constexpr std::uint32_t CORNER_BITS = 2;
+    static constexpr std::uint32_t TILE_BITS = 6;
+
+    static constexpr std::uint32_t NORMAL_SHIFT = 3 * POSITION_BITS;
+    static constexpr std::uint32_t CORNER_SHIFT = NORMAL_SHIFT + NORMAL_BITS;
+    static constexpr std::uint32_t TILE_SHIFT = CORNER_SHIFT + CORNER_BITS;
+
+    std::uint32_t data;
+
+    [[nodiscard]] static constexpr Vertex pack(std::uint32_t x, std::uint32_t y, std::uint32_t z,
+                                               std::uint32_t normal, std::uint32_t corner, std::uint32_t tile)
+    {
+        return Vertex { x
+            | (y << POSITION_BITS)
+            | (z << (2 * POSITION_BITS))
+            | (normal << NORMAL_SHIFT)
+            | (corner << CORNER_SHIFT)
+            | (tile << TILE_SHIFT) };
+    }
+
+    [[nodiscard]] constexpr std::uint32_t x() const { return field(0, POSITION_BITS); }
+    [[nodiscard]] constexpr std::uint32_t y() const { return field(POSITION_BITS, POSITION_BITS); }
+    [[nodiscard]] constexpr std::uint32_t z() const { return field(2 * POSITION_BITS, POSITION_BITS); }
+    [[nodiscard]] constexpr std::uint32_t normal() const { return field(NORMAL_SHIFT, NORMAL_BITS); }
+    [[nodiscard]] constexpr std::uint32_t corner() const { return field(CORNER_SHIFT, CORNER_BITS); }
+    [[nodiscard]] constexpr std::uint32_t tile() const { return field(TILE_SHIFT, TILE_BITS); }
+
+private:
+    [[nodiscard]] constexpr std::uint32_t field(std::uint32_t shift, std::uint32_t bits) const
+    {
+        return (data >> shift) & ((std::uint32_t{1} << bits) - 1);
+    }
+};
+
+static_assert(sizeof(Vertex) == 4);
+static_assert(Vertex::TILE_SHIFT + Vertex::TILE_BITS == 32);
+static_assert(Vertex::pack(64, 0, 33, 5, 3, 63).x() == 64);
+static_assert(Vertex::pack(64, 0, 33, 5, 3, 63).y() == 0);
+static_assert(Vertex::pack(64, 0, 33, 5, 3, 63).z() == 33);
+static_assert(Vertex::pack(64, 0, 33, 5, 3, 63).normal() == 5);
+static_assert(Vertex::pack(64, 0, 33, 5, 3, 63).corner() == 3);
+static_assert(Vertex::pack(64, 0, 33, 5, 3, 63).tile() == 63);
+static_assert(Vertex::pack(1, 64, 2, 0, 0, 0).y() == 64);
@@ -31,9 +31,37 @@ World::~World() = default;
 
 void World::set(int x, int y, int z, BlockType type)
 {
-    assert(false);
-    //TODO: Implement with event
-    //chunk->set(x % ChunkData::BLOCKS_X, y % ChunkData::BLOCKS_Y, z % ChunkData::BLOCKS_Z, type);
+    m_chunks.setBlock({ x, y, z }, type);
+}
+
+void World::setUploadBudget(const UploadBudget& budget)
+{
+    m_chunks.setUploadBudget(budget);
+}
+
+void World::setIncrementalEdits(bool enabled)
+{
+    m_chunks.setIncrementalEdits(enabled);
+}
+
+void World::setLodRings(const LodRings& rings)
+{
+    m_chunks.setLodRings(rings);
+}
+
+void World::setDensitySampling(const DensitySampling& sampling)
+{
+    m_chunks.setDensitySampling(sampling);
+}
+
+void World::compareDensitySampling()
+{
+    m_chunks.compareDensitySampling();
+}
+
+ChunkStats World::chunkStats() const
+{
+    return m_chunks.stats();
 }
 
 void World::render(const glm::vec3& playerPos, const Shader& shader, const glm::mat4& viewProjectionMatrix)
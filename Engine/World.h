@@ -23,6 +23,14 @@ public:
     void render(const glm::vec3& playerPos, const Shader& shader, const glm::mat4& viewProjectionMatrix);
     void set(int x, int y, int z, BlockType type);
 
+    void setUploadBudget(const UploadBudget& budget);
+    void setIncrementalEdits(bool enabled);
+    void setLodRings(const LodRings& rings);
+    void setDensitySampling(const DensitySampling& sampling);
+    void compareDensitySampling();
+
+    [[nodiscard]] ChunkStats chunkStats() const;
+
 private:
     Observer m_observer;
 
@@ -3,7 +3,15 @@
 
 EventQueue::~EventQueue()
 {
-    m_stopThread = true;
+    stop();
+}
+
+void EventQueue::stop()
+{
+    {
+        std::unique_lock<std::mutex> lck(m_eventQueueMutex);
+        m_stopThread = true;
+    }
     m_eventQueueCond.notify_all();
 }
 
@@ -22,6 +22,9 @@ public:
     ~EventQueue();
     void addEvent(std::unique_ptr<Event> ev);
 
+    // Wakes up the thread waiting in nextEvent(), which then returns an empty event
+    void stop();
+
     // Will block thread until there is a new event
     std::shared_ptr<Event> nextEvent();
 
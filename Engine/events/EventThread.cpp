@@ -1,6 +1,6 @@
 #include "EventThread.h"
 
-EventThread::EventThread()
+void EventThread::start()
 {
 	m_thread = std::thread([this]() {
 		onStart();
@@ -9,6 +9,9 @@ EventThread::EventThread()
 
 			// Will block until new event on queue
 			auto event = m_events.nextEvent();
+			if (m_stopThread.load()) {
+				break;
+			}
 			handleEvent(event.get());
 		}
 
@@ -19,6 +22,7 @@ EventThread::EventThread()
 void EventThread::stop()
 {
 	m_stopThread = true;
+	m_events.stop();
 }
 
 void EventThread::join()
@@ -13,9 +13,12 @@
 class EventThread
 {
 public:
-	EventThread();
+	EventThread() = default;
 	virtual ~EventThread() = default;
 
+	// Starts the thread, which calls onStart() before handling events. Must be called once the
+	// derived class is constructed, since the thread calls its virtual functions.
+	void start();
 	void stop();
 	void join();
 	
@@ -2,6 +2,10 @@
 #include <fstream>
 #include <memory>
 #include <array>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
 
 #ifdef _WIN32
 #define NOMINMAX
@@ -26,6 +30,9 @@
 #include "Engine/Camera.h"
 #include "Engine/World.h"
 #include "Engine/Logger.h"
+#include "Engine/BatchNoise.h"
+#include "Engine/GpuBufferPool.h"
+#include "Engine/JobSystem.h"
 #include "Engine/utils/Chunkindex.h"
 #include "Engine/utils/Observer.h"
 #include "Engine/GameEventDispatcher.h"
@@ -35,10 +42,19 @@ struct Config
     bool wireframe = false;
     bool vsync = false;
     bool fullscreen = false;
+    int meshingMode = int(MeshingMode::Binary);
+    int uploadBudgetKiB = int(UploadBudget{}.bytesPerFrame / 1024);
+    float uploadBudgetMs = UploadBudget{}.millisecondsPerFrame;
+    bool incrementalEdits = true;
+    int halfDetailRing = LodRings{}.halfDetail;
+    int quarterDetailRing = LodRings{}.quarterDetail;
+    int densitySpacing = 2; // Index into the "Density sampling" combo: every 1, 2, 4 or 8 blocks
+    float densityRefineMargin = DensitySampling{}.refineMargin;
 };
 
 struct Stats {
     std::size_t currentFPS = 0;
+    std::array<double, 3> noisePointsPerSecond {}; // Indexed by NoiseKernel, filled on request
 };
 
 namespace
@@ -48,11 +64,24 @@ namespace
 Stats stats;
 Config config;
 Engine::Camera* playerCamera;
+Engine::World* gameWorld;
 
 bool showingConfig = false;
 
 auto& s_windowManager = Engine::WindowManager::instance();
 
+// Removes random blocks around the camera, to compare the latency of patched and remeshed edits
+void digBlocks()
+{
+    static std::mt19937 rng { std::random_device{}() };
+    std::uniform_int_distribution<int> offset { -8, 8 };
+    const auto center = glm::ivec3(glm::floor(playerCamera->position.get()));
+    for (int i = 0; i < 64; i++) {
+        const auto pos = center + glm::ivec3{ offset(rng), offset(rng) - 16, offset(rng) };
+        gameWorld->set(pos.x, pos.y, pos.z, Engine::BlockType::AIR);
+    }
+}
+
 } // anon namespace
 
 void renderImGui()
@@ -76,6 +105,54 @@ void renderImGui()
             );
         }
 
+        if (ImGui::Combo("Meshing", &config.meshingMode, "Naive\0Binary\0Greedy\0\0")) {
+            ChunkMesh::setMode(MeshingMode(config.meshingMode));
+        }
+
+        const auto uploadKiBChanged = ImGui::SliderInt("Upload KiB/frame", &config.uploadBudgetKiB, 64, 65536);
+        const auto uploadMsChanged = ImGui::SliderFloat("Upload ms/frame", &config.uploadBudgetMs, 0.1f, 16.0f);
+        if (uploadKiBChanged || uploadMsChanged) {
+            gameWorld->setUploadBudget({ std::size_t(config.uploadBudgetKiB) * 1024, config.uploadBudgetMs });
+        }
+
+        const auto halfRingChanged = ImGui::SliderInt("LOD 2x from chunk", &config.halfDetailRing, 1, 8);
+        const auto quarterRingChanged = ImGui::SliderInt("LOD 4x from chunk", &config.quarterDetailRing, 1, 8);
+        if (halfRingChanged || quarterRingChanged) {
+            gameWorld->setLodRings({ config.halfDetailRing, config.quarterDetailRing });
+        }
+
+        const auto spacingChanged = ImGui::Combo("Density sampling", &config.densitySpacing, "Exact\0Every 2\0Every 4\0Every 8\0\0");
+        const auto marginChanged = ImGui::SliderFloat("Density refine margin", &config.densityRefineMargin, 0.0f, 0.2f);
+        if (spacingChanged || marginChanged) {
+            gameWorld->setDensitySampling({ 1 << config.densitySpacing, config.densityRefineMargin });
+        }
+
+        if (ImGui::Button("Compare with exact")) {
+            gameWorld->compareDensitySampling();
+        }
+
+        if (ImGui::Checkbox("Patch edits", &config.incrementalEdits)) {
+            gameWorld->setIncrementalEdits(config.incrementalEdits);
+        }
+
+        if (ImGui::Button("Dig blocks")) {
+            digBlocks();
+        }
+
+        if (ImGui::Button("Benchmark noise")) {
+            const auto noise = BatchNoise{ siv::BasicPerlinNoise<float>{} };
+            for (const auto kernel : { NoiseKernel::Scalar, NoiseKernel::SSE41, NoiseKernel::AVX2 }) {
+                stats.noisePointsPerSecond.at(std::size_t(kernel)) = noise.benchmark(kernel);
+            }
+        }
+        for (const auto kernel : { NoiseKernel::Scalar, NoiseKernel::SSE41, NoiseKernel::AVX2 }) {
+            const auto pointsPerSecond = stats.noisePointsPerSecond.at(std::size_t(kernel));
+            if (pointsPerSecond > 0.0) {
+                const auto text = std::string(BatchNoise::name(kernel)) + ": " + std::to_string(pointsPerSecond / 1e6) + " Mpoints/s";
+                ImGui::Text("%s", text.c_str());
+            }
+        }
+
         ImGui::End();
     }
 
@@ -93,6 +170,53 @@ void renderImGui()
     ImGui::Text("%s", posYText.c_str());
     ImGui::Text("%s", posZText.c_str());
 
+    constexpr auto bytesPerMiB = 1024.0 * 1024.0;
+    const auto chunkStats = gameWorld->chunkStats();
+    const auto chunksText = std::string("Chunks: ") + std::to_string(chunkStats.chunks);
+    const auto uniformChunksText = std::string("Uniform chunks: ") + std::to_string(chunkStats.uniformChunks);
+    const auto sectionsText = std::string("Sections: ") + std::to_string(chunkStats.allocatedSections) + " / " + std::to_string(chunkStats.chunks * ChunkData::SECTIONS);
+    const auto generationText = std::string("Generation: ") + std::to_string(chunkStats.averageGenerationMs) + " ms/chunk (" + BatchNoise::name(BatchNoise::kernel()) + " noise)";
+    const auto densityText = std::string("Density: ") + std::to_string(chunkStats.averageDensityEvaluations) + " evaluations/chunk, "
+        + std::to_string(chunkStats.densityDifferenceRate * 100.0) + "% of " + std::to_string(chunkStats.comparedBlocks) + " blocks differ";
+    const auto classificationText = std::string("Classified air: ") + std::to_string(chunkStats.airAboveMaxHeight) + " above max height, "
+        + std::to_string(chunkStats.airAboveSurface) + " above surface, " + std::to_string(chunkStats.sampledChunks) + " sampled ("
+        + std::to_string(chunkStats.averageSampledLayers) + " layers)";
+    const auto jobsText = std::string("Jobs: ") + std::to_string(JobSystem::instance().workerCount()) + " workers, "
+        + std::to_string(JobSystem::instance().stolenJobs()) + " stolen";
+    const auto bufferStats = Engine::GpuBufferPool::instance().stats();
+    const auto gpuBuffersText = std::string("GPU buffers: ") + std::to_string(bufferStats.created) + " created, " + std::to_string(bufferStats.reused) + " reused, "
+        + std::to_string(bufferStats.pooled) + " pooled, " + std::to_string(bufferStats.deleted) + " deleted";
+    const auto renderListText = std::string("Render list: ") + std::to_string(chunkStats.renderListEpoch) + " published, "
+        + std::to_string(chunkStats.retiredChunks) + " retired chunks, " + std::to_string(chunkStats.chunksMutexContentions) + " lock waits";
+    const auto meshingText = std::string("Meshing: ") + std::to_string(chunkStats.averageMeshingMs) + " ms/chunk";
+    const auto verticesText = std::string("Vertices: ") + std::to_string(chunkStats.lastFrameDrawnVertices) + " drawn / " + std::to_string(chunkStats.vertices);
+    const auto lodText = std::string("LOD chunks: ") + std::to_string(chunkStats.lodChunks[0]) + " / " + std::to_string(chunkStats.lodChunks[1]) + " / " + std::to_string(chunkStats.lodChunks[2]);
+    const auto uploadedText = std::string("Uploaded: ") + std::to_string(double(chunkStats.uploadedBytes) / bytesPerMiB) + " MiB";
+    const auto uploadQueueText = std::string("Upload queue: ") + std::to_string(chunkStats.pendingUploads) + " chunks, " + std::to_string(double(chunkStats.lastFrameUploadedBytes) / 1024.0) + " KiB/frame";
+    const auto editsText = std::string("Edits: patched ") + std::to_string(chunkStats.patchLatencyMs) + " ms (" + std::to_string(chunkStats.patchedEdits)
+        + "), remeshed " + std::to_string(chunkStats.remeshLatencyMs) + " ms (" + std::to_string(chunkStats.remeshedEdits) + ")";
+    const auto meshMemoryText = std::string("Mesh memory: ") + std::to_string(double(chunkStats.meshMemory) / bytesPerMiB) + " MiB (peak " + std::to_string(double(chunkStats.peakMeshMemory) / bytesPerMiB) + " MiB)";
+    const auto blockMemoryText = std::string("Block memory: ") + std::to_string(double(chunkStats.blockMemory) / bytesPerMiB) + " MiB";
+    const auto flatMemoryText = std::string("(flat array: ") + std::to_string(double(chunkStats.chunks * ChunkData::BLOCKS * sizeof(Engine::BlockType)) / bytesPerMiB) + " MiB)";
+    ImGui::Text("%s", chunksText.c_str());
+    ImGui::Text("%s", uniformChunksText.c_str());
+    ImGui::Text("%s", sectionsText.c_str());
+    ImGui::Text("%s", generationText.c_str());
+    ImGui::Text("%s", densityText.c_str());
+    ImGui::Text("%s", classificationText.c_str());
+    ImGui::Text("%s", meshingText.c_str());
+    ImGui::Text("%s", jobsText.c_str());
+    ImGui::Text("%s", gpuBuffersText.c_str());
+    ImGui::Text("%s", renderListText.c_str());
+    ImGui::Text("%s", verticesText.c_str());
+    ImGui::Text("%s", lodText.c_str());
+    ImGui::Text("%s", uploadedText.c_str());
+    ImGui::Text("%s", uploadQueueText.c_str());
+    ImGui::Text("%s", editsText.c_str());
+    ImGui::Text("%s", meshMemoryText.c_str());
+    ImGui::Text("%s", blockMemoryText.c_str());
+    ImGui::Text("%s", flatMemoryText.c_str());
+
     ImGui::End();
 
     ImGui::Render();
@@ -107,6 +231,65 @@ int main(int argc, char* argv[])
 
     std::cout << "Running main thread with id: " << std::this_thread::get_id() << "\n";
 
+    // Loads the world without rendering it, with 1 up to all workers, and exits
+    if (argc > 1 && std::string(argv[1]) == "--benchmark-load") {
+        std::vector<std::size_t> workerCounts;
+        for (std::size_t workers = 1; workers < JobSystem::defaultWorkerCount(); workers *= 2) {
+            workerCounts.push_back(workers);
+        }
+        workerCounts.push_back(JobSystem::defaultWorkerCount());
+
+        auto singleWorker = 0.0;
+        for (const auto workers : workerCounts) {
+            const auto chunksPerSecond = ChunkManager::benchmarkWorldLoad(workers);
+            singleWorker = workers == 1 ? chunksPerSecond : singleWorker;
+            std::cout << workers << " workers: " << chunksPerSecond << " chunks/s (" << chunksPerSecond / singleWorker << "x)\n";
+        }
+        return 0;
+    }
+
+    // Compares the block storage of the loaded world with flat arrays, and exits
+    if (argc > 1 && std::string(argv[1]) == "--benchmark-storage") {
+        constexpr auto bytesPerMiB = 1024.0 * 1024.0;
+        const auto result = ChunkManager::benchmarkBlockStorage();
+        std::cout << result.chunks << " chunks, block memory: palette " << double(result.paletteBytes) / bytesPerMiB << " MiB, flat "
+                  << double(result.flatBytes) / bytesPerMiB << " MiB\n"
+                  << "get: palette " << result.paletteGetsPerSecond / 1e6 << " M/s, flat " << result.flatGetsPerSecond / 1e6 << " M/s\n"
+                  << "set: palette " << result.paletteSetsPerSecond / 1e6 << " M/s, flat " << result.flatSetsPerSecond / 1e6 << " M/s\n"
+                  << result.mismatches << " mismatched blocks\n";
+        return result.mismatches == 0 ? 0 : 1;
+    }
+
+    // Counts the vertices and bytes of the chunk meshes as triangles and as indexed quads, and exits
+    if (argc > 1 && std::string(argv[1]) == "--benchmark-mesh") {
+        const std::array<const char*, 3> modeNames = { "naive", "binary", "greedy" };
+        for (const auto& result : ChunkManager::benchmarkMesh()) {
+            const auto kiB = [](double vertices) { return vertices * double(sizeof(Vertex)) / 1024.0; };
+            std::cout << modeNames.at(std::size_t(result.mode)) << ", " << result.chunks << " chunks, per chunk: " << result.faces << " faces, "
+                      << result.triangleVertices << " vertices (" << kiB(result.triangleVertices) << " KiB) as triangles, "
+                      << result.quadVertices << " vertices (" << kiB(result.quadVertices) << " KiB) as indexed quads, "
+                      << result.uploadedVertices << " vertices (" << kiB(result.uploadedVertices) << " KiB) uploaded with spare capacity; "
+                      << double(result.indexBufferBytes) / 1024.0 << " KiB shared indices\n";
+        }
+        return 0;
+    }
+
+    // Checks that the binary mesher emits the same faces as the naive one, and exits
+    if (argc > 1 && std::string(argv[1]) == "--check-meshers") {
+        const auto result = ChunkManager::compareMeshers();
+        std::cout << result.chunks << " chunks, " << result.faces << " faces, " << result.mismatchedChunks << " with different faces\n"
+                  << "naive: " << result.naiveMs << " ms/chunk, binary: " << result.binaryMs << " ms/chunk\n";
+        return result.mismatchedChunks == 0 ? 0 : 1;
+    }
+
+    // Loads and unloads chunks while reading the render lists like the render thread, and exits
+    if (argc > 1 && std::string(argv[1]) == "--stress-render-list") {
+        const auto stats = ChunkManager::stressRenderList(std::chrono::seconds(10));
+        std::cout << stats.renderListEpoch << " render lists published, " << stats.retiredChunks << " unloaded chunks not destroyed yet, "
+                  << stats.chunksMutexContentions << " waits for the loaded chunks, " << stats.renderListMismatches << " mismatched chunks\n";
+        return stats.renderListMismatches == 0 ? 0 : 1;
+    }
+
     SDL_Window* window = Engine::WindowManager::instance().sdlWindow();
 
     ImGui_ImplSdlGL3_Init(window);
@@ -142,6 +325,8 @@ int main(int argc, char* argv[])
     SDL_Event event{};
 
     const Engine::Shader simpleShader("shaders/shader.vert", "shaders/shader.frag");
+    simpleShader.use();
+    simpleShader.setUniform("tileRects", ChunkMesh::atlasTiles());
 
     std::array<float,3> backgroundColor{0.2f, 0.2f, 0.8f};
 
@@ -150,6 +335,7 @@ int main(int argc, char* argv[])
     playerCamera = &camera;
 
     auto world = Engine::World{texture, playerCamera};
+    gameWorld = &world;
 
     GameEventDispatcher gameEvents;
 
@@ -1,13 +1,24 @@
 #version 420
 
+#define NUM_TILES 4
+
 precision highp float;
 
 in vec2 texCoordOut;
+flat in uint tileOut;
 
 layout(binding = 0) uniform sampler2D colortexture;
 
+// Atlas rectangle (min u, min v, max u, max v) of every block texture
+uniform vec4 tileRects[NUM_TILES];
+
 layout(location = 0) out vec4 fragColor;
 
 void main() {
-    fragColor = texture(colortexture, texCoordOut);;//vec3(1.0f, 0.0f, 0.0f);
+    // texCoordOut counts tiles across a possibly merged face, so wrap it into the tile's atlas rectangle.
+    // The gradients come from the unwrapped coordinate to avoid mip seams where the tile repeats.
+    vec4 rect = tileRects[tileOut];
+    vec2 tileSize = rect.zw - rect.xy;
+    vec2 atlasCoord = rect.xy + fract(texCoordOut) * tileSize;
+    fragColor = textureGrad(colortexture, atlasCoord, dFdx(texCoordOut) * tileSize, dFdy(texCoordOut) * tileSize);
 }
\ No newline at end of file
@@ -1,20 +1,35 @@
 #version 420
 
-#define NUM_BLOCK_TYPES 4
-
-layout (location = 0) in vec2 texCoord;
-layout (location = 1) in vec3 pos;
-
+// Unpacks the 32 bit Vertex from Engine/Vertex.h
+layout (location = 0) in uint packedVertex;
 
 uniform mat4 modelViewProjectionMatrix;
 
-//uniform vec2 texLookup[NUM_BLOCK_TYPES*6];
+// Sign of the texture u axis for every face direction (-X, +X, -Y, +Y, -Z, +Z), so the texture
+// is not mirrored on the faces pointing the other way. Matches faceCorners in ChunkMesh.cpp.
+const float uSigns[6] = float[6](1.0, -1.0, -1.0, 1.0, -1.0, 1.0);
 
 //out vec3 color;
 out vec2 texCoordOut;
+flat out uint tileOut;
 
 void main(){
-    gl_Position = modelViewProjectionMatrix * vec4(pos.xyz, 1.0);
-
-    texCoordOut = texCoord;//texLookup[uint(pos.w)];
+    vec3 pos = vec3(packedVertex & 127u, (packedVertex >> 7) & 127u, (packedVertex >> 14) & 127u);
+    uint normal = (packedVertex >> 21) & 7u;
+
+    gl_Position = modelViewProjectionMatrix * vec4(pos, 1.0);
+
+    // Project the position onto the face plane, in tiles, so a merged face repeats its texture once per block
+    vec2 texCoord;
+    if (normal < 2u) {
+        texCoord = pos.zy;
+    }
+    else if (normal < 4u) {
+        texCoord = pos.zx;
+    }
+    else {
+        texCoord = pos.xy;
+    }
+    texCoordOut = vec2(texCoord.x * uSigns[normal], texCoord.y);
+    tileOut = packedVertex >> 26;
 }
\ No newline at end of file